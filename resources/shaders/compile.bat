@@ -1,4 +1,26 @@
 C:/VulkanSDK/1.3.275.0/Bin/glslc.exe shader.vert --target-env=vulkan1.3 -o vert.spv
 C:/VulkanSDK/1.3.275.0/Bin/glslc.exe shader.frag --target-env=vulkan1.3 -o frag.spv
 C:/VulkanSDK/1.3.275.0/Bin/glslc.exe shader.comp --target-env=vulkan1.3 -o comp.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe shader.comp --target-env=vulkan1.3 -DMETRIC=1 -o comp_schwarzschild.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe shader.comp --target-env=vulkan1.3 -DMETRIC=2 -o comp_kerr.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe classify.comp --target-env=vulkan1.3 -o classify.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe wavefront.comp --target-env=vulkan1.3 -DSTAGE=0 -o wavefront_raygen.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe wavefront.comp --target-env=vulkan1.3 -DSTAGE=1 -o wavefront_bend.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe wavefront.comp --target-env=vulkan1.3 -DSTAGE=2 -o wavefront_intersect.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe wavefront.comp --target-env=vulkan1.3 -DSTAGE=3 -o wavefront_shade.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe wavefront.comp --target-env=vulkan1.3 -DSTAGE=4 -o wavefront_resolve.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe wavefront.comp --target-env=vulkan1.3 -DSTAGE=0 -DMETRIC=1 -o wavefront_raygen_schwarzschild.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe wavefront.comp --target-env=vulkan1.3 -DSTAGE=1 -DMETRIC=1 -o wavefront_bend_schwarzschild.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe wavefront.comp --target-env=vulkan1.3 -DSTAGE=2 -DMETRIC=1 -o wavefront_intersect_schwarzschild.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe wavefront.comp --target-env=vulkan1.3 -DSTAGE=3 -DMETRIC=1 -o wavefront_shade_schwarzschild.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe wavefront.comp --target-env=vulkan1.3 -DSTAGE=4 -DMETRIC=1 -o wavefront_resolve_schwarzschild.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe wavefront.comp --target-env=vulkan1.3 -DSTAGE=0 -DMETRIC=2 -o wavefront_raygen_kerr.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe wavefront.comp --target-env=vulkan1.3 -DSTAGE=1 -DMETRIC=2 -o wavefront_bend_kerr.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe wavefront.comp --target-env=vulkan1.3 -DSTAGE=2 -DMETRIC=2 -o wavefront_intersect_kerr.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe wavefront.comp --target-env=vulkan1.3 -DSTAGE=3 -DMETRIC=2 -o wavefront_shade_kerr.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe wavefront.comp --target-env=vulkan1.3 -DSTAGE=4 -DMETRIC=2 -o wavefront_resolve_kerr.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe persistent.comp --target-env=vulkan1.3 -o persistent.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe temporal.comp --target-env=vulkan1.3 -o temporal.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe atrous.comp --target-env=vulkan1.3 -o atrous.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe present.comp --target-env=vulkan1.3 -o present.spv
 pause
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef PRESENT_GLSL
+#define PRESENT_GLSL
+
+// Shared present library, included by both present passes (present.comp, which writes the swapchain directly, and the fallback shader.frag)
+// Passes must enable GL_GOOGLE_include_directive before including this.
+
+#include "../../src/glsl_cpp_common.h"
+
+// The (HDR) output image of the compute pass
+layout(set = 0, binding = 0) uniform sampler2D imageSampler;
+
+// (Only part of the image is traced this frame, the rest is stale, see updateTraceExtent)
+layout(set = 0, binding = 1) uniform PresentUBO {
+    RTPresent present;
+};
+
+/**
+ *  Samples the traced part of the image with a Catmull-Rom filter, which stays sharp when upscaling.
+ *  Uses 9 bilinear taps rather than 16 point taps, by merging the two middle taps of every row and column.
+ *  (Explicitly of the base level, as compute shaders have no implicit level of detail)
+ *
+ *  @param position The position, in texels.
+ */
+vec4 SampleCatmullRom(vec2 position) {
+    vec2    texelSize = 1.0 / vec2(textureSize(imageSampler, 0)),
+            center = floor(position - 0.5) + 0.5,
+            f = position - center;
+
+    vec2    w0 = f * (-0.5 + f * (1.0 - 0.5 * f)),
+            w1 = 1.0 + f * f * (-2.5 + 1.5 * f),
+            w2 = f * (0.5 + f * (2.0 - 1.5 * f)),
+            w3 = f * f * (-0.5 + 0.5 * f),
+            w12 = w1 + w2;
+
+    // (Taps are clamped to the traced part, so its edges don't bleed in stale texels)
+    vec2    lo = vec2(0.5), hi = present.traceSize - 0.5,
+            p0 = clamp(center - 1.0, lo, hi) * texelSize,
+            p12 = clamp(center + w2 / w12, lo, hi) * texelSize,
+            p3 = clamp(center + 2.0, lo, hi) * texelSize;
+
+    vec4 color = vec4(0);
+    color += textureLod(imageSampler, vec2(p0.x,  p0.y), 0.0)  * w0.x  * w0.y;
+    color += textureLod(imageSampler, vec2(p12.x, p0.y), 0.0)  * w12.x * w0.y;
+    color += textureLod(imageSampler, vec2(p3.x,  p0.y), 0.0)  * w3.x  * w0.y;
+    color += textureLod(imageSampler, vec2(p0.x,  p12.y), 0.0) * w0.x  * w12.y;
+    color += textureLod(imageSampler, vec2(p12.x, p12.y), 0.0) * w12.x * w12.y;
+    color += textureLod(imageSampler, vec2(p3.x,  p12.y), 0.0) * w3.x  * w12.y;
+    color += textureLod(imageSampler, vec2(p0.x,  p3.y), 0.0)  * w0.x  * w3.y;
+    color += textureLod(imageSampler, vec2(p12.x, p3.y), 0.0)  * w12.x * w3.y;
+    color += textureLod(imageSampler, vec2(p3.x,  p3.y), 0.0)  * w3.x  * w3.y;
+
+    // (The negative lobes may ring below zero around sharp edges)
+    return max(color, 0.0);
+}
+
+/**
+ *  Maps an HDR color into [0, 1], see TONEMAP_*.
+ */
+vec3 Tonemap(vec3 color) {
+    if (present.tonemap == TONEMAP_REINHARD) {
+        float luminance = dot(color, vec3(0.2126, 0.7152, 0.0722));
+        return clamp(color / (1.0 + luminance), 0.0, 1.0);
+    }
+    if (present.tonemap == TONEMAP_ACES)
+        return clamp((color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+    return clamp(color, 0.0, 1.0);
+}
+
+/**
+ *  Gets the exposed and tonemapped color of the output image, in linear [0, 1].
+ *
+ *  @param uv The position on the screen, [0, 1].
+ */
+vec3 PresentColor(vec2 uv) {
+    vec3 color = SampleCatmullRom(uv * present.traceSize).rgb;
+    return Tonemap(color * exp2(present.exposure));
+}
+
+#endif
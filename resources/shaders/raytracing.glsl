@@ -0,0 +1,1455 @@
+#ifndef RAYTRACING_GLSL
+#define RAYTRACING_GLSL
+
+// Shared ray tracing library, included by every tracing kernel (shader.comp, wavefront.comp, ...)
+// Kernels must enable GL_GOOGLE_include_directive before including this.
+
+#include "../../src/glsl_cpp_common.h"
+
+// --- Macros ---
+#ifndef METRIC
+#define METRIC METRIC_NEWTONIAN
+#endif
+#define HitInfo0 HitInfo( false, 0.0, vec3(0), vec3(0), RTMaterial(vec4(0), vec4(0), vec4(0), 0.0), RT_PRIMITIVE_NONE )
+
+// --- Constants ---
+const float PI = radians(180);
+const bool  CLIP_MESHES = false; // Disable until triangle raycasting becomes more expensive
+const bool  CURVED_SEGMENTS = true; // Model each step as a parabolic arc instead of a straight line
+const float RAY_STEP_FACTOR = CURVED_SEGMENTS ? 1.0 : 0.5; // Step distance relative to the distance to the black hole
+const int   ARC_NEWTON_ITERATIONS = 2;
+const int   VOLUME_SAMPLES_PER_CELL = 4;
+const int   VOLUME_MAX_SAMPLES = 64; // Per volume and segment (longer segments are sampled more sparsely)
+const float VOLUME_MIN_TRANSMITTANCE = 0.02;
+const int   SDF_MAX_STEPS = 48; // Per object and segment
+const float SDF_HIT_EPSILON = 0.002;
+const float SDF_MAX_DIST = 100.0;
+const float GRIN_STEP_SCALE = 0.2; // Step distance relative to n / |grad n| inside refractive media
+const float GRIN_MIN_STEP = 0.02;
+const int   GRIN_MAX_STEPS = 64; // Extra ray subdivisions for steps taken inside refractive media
+
+const float kEpsilion = 0.001; // Rename to K_EPSILION?
+
+// --- Specialization constants ---
+// (Set per pipeline, see specialization.hpp, so they are folded like constants without recompiling the SPIR-V)
+layout (constant_id = SPEC_RAY_SUBDIVISIONS) const int RAY_SUBDIVISIONS = 8; // (15 suits straight segments)
+layout (constant_id = SPEC_CULL_FACE) const bool CULL_FACE = true; // Ignore hits on the inside of spheres
+layout (constant_id = SPEC_RAY_STEP_RANDOMNESS) const float RAY_STEP_RANDOMNESS = 0.025;
+layout (constant_id = SPEC_HAS_SPHERES) const bool HAS_SPHERES = true; // Whether the scene has any of these at all,
+layout (constant_id = SPEC_HAS_TORI) const bool HAS_TORI = true;       // so their loops are compiled out when not
+layout (constant_id = SPEC_HAS_HOLES) const bool HAS_HOLES = true;
+
+// --- Structs ---
+// Hit information
+struct HitInfo {
+    bool        didHit;
+    float       dist;
+    vec3        pos;
+    vec3        normal;
+    RTMaterial    material;
+    uint        id; // See RT_PRIMITIVE_*
+};
+
+// Ray
+// (Within a segment, the ray follows origin + dir*t + 0.5*accel*t^2)
+struct Ray {
+    vec3 origin;
+    vec3 dir;
+    vec3 accel;
+    bool destroyed;
+};
+
+// --- Input/Output ---
+layout (binding = b_frame) uniform FrameUBO {
+    RTFrame frameState;
+};
+
+// This frame's state, as read by the functions below
+// (Copied from frameState by LoadFrame at the start of every kernel, so that the wavefront kernels can adjust it per wave)
+RTFrame frame;
+
+void LoadFrame() {
+    frame = frameState;
+}
+
+// UBO input parameters
+layout (binding = b_params) uniform ParameterUBO {
+    RTParams ubo;
+};
+
+// Spheres in and out
+layout(std140, binding = b_spheres) readonly buffer SphereSSBOIn {
+   RTSphere spheresIn[ ];
+};
+
+layout(std140, binding = b_blackholes) readonly buffer BlackholeSSBOIn {
+   RTBlackhole blackholesIn [ ];
+};
+
+// Output storage image
+layout (binding = b_image) writeonly uniform image2D image; // (HDR, in a format picked at runtime, see chooseOutputFormat)
+
+// Accumulated light of a still view (rgb: sum, a: number of samples), shared by all frames in flight
+layout (binding = b_accumulation, rgba32f) uniform image2D accumulationImage;
+
+// Accumulated squared luminance, for estimating variance
+layout (binding = b_moments, r32f) uniform image2D momentsImage;
+
+// First hit of every pixel, see RT_HIT_*
+// (Double buffered by frame parity, rows [0, height) for even frames and [height, 2 * height) for odd ones)
+layout (binding = b_hitBuffer, rgba32f) uniform image2D hitImage;
+
+// Normal (xyz) and primitive id (w) of every pixel's first hit, for this frame only
+layout (binding = b_hitNormal, rgba32f) writeonly uniform image2D hitNormalImage;
+
+// Weights of the sample budget map, RT_BUDGET_MAP_SIZE^2 row by row (see budget.hpp)
+layout (std430, binding = b_budgetMap) readonly buffer BudgetMapSSBOIn {
+    float budgetMap[ ];
+};
+
+// Tiles to trace this frame, see classify.comp
+layout (std430, binding = b_tiles) readonly buffer TileSSBOIn {
+    uint dispatchX, dispatchY, dispatchZ;
+    uint tiles [ ];
+};
+
+// Skybox texture
+layout(binding = b_skybox) uniform sampler2D imageSampler;
+
+layout(std140, binding = b_torus) readonly buffer TorusSSBOIn {
+   RTTorus torusIn [ ];
+};
+
+layout(std140, binding = b_disks) readonly buffer DiskSSBOIn {
+   RTDisk disksIn [ ];
+};
+
+layout(std140, binding = b_volumes) readonly buffer VolumeSSBOIn {
+   RTVolume volumesIn [ ];
+};
+
+// Volume density/emission texture and its occupancy grid
+layout(binding = b_volumeTexture) uniform sampler3D volumeSampler;
+
+layout(std430, binding = b_volumeOccupancy) readonly buffer VolumeOccupancySSBOIn {
+   uint volumeOccupancy [ ];
+};
+
+// SDF trees and the objects using them
+layout(std140, binding = b_sdfNodes) readonly buffer SdfNodeSSBOIn {
+   RTSdfNode sdfNodesIn [ ];
+};
+
+layout(std140, binding = b_sdfObjects) readonly buffer SdfObjectSSBOIn {
+   RTSdfObject sdfObjectsIn [ ];
+};
+
+// Refractive media and their shared index texture (rgb: gradient, a: n - 1)
+layout(std140, binding = b_media) readonly buffer MediumSSBOIn {
+   RTMedium mediaIn [ ];
+};
+
+layout(binding = b_refractionTexture) uniform sampler3D refractionSampler;
+
+// Kerr transfer tables (only used by the Kerr variant, and repeating along psi, which is periodic)
+layout(binding = b_kerrDirection) uniform sampler3D kerrDirectionSampler;
+layout(binding = b_kerrExit) uniform sampler3D kerrExitSampler;
+
+// --- Globals ---
+// First hit of the ray being traced (w: RT_HIT_*), and its direction when it hit
+vec4 firstHit;
+vec3 firstHitDir;
+vec4 firstHitNormal; // w: primitive id
+
+// --- Utility functions ---
+float Luminance(vec3 color) {
+    return dot( color, vec3(0.2126, 0.7152, 0.0722) );
+}
+
+// --- Randomness functions ---
+
+// www.pcg-random.org, www.shadertoy.com/view/XlGcRh
+/**
+ * Generates a psuedo-random unsigned integer with value [0, 2^32 - 1].
+ *
+ * @param seed The seed, which is changed after use.
+ * @return A psuedo-random unsigned integer.
+ */
+uint randInt(inout uint seed) {
+    seed = seed * 747796405 + 2891336453;
+    uint result = ((seed >> ((seed >> 28) + 4)) ^ seed) * 277803737;
+    result = (result >> 22) ^ result;
+    return result;
+}
+
+/**
+ * Generates a psuedo-float with value [0, 1].
+ *
+ * @param seed The seed, which is changed after use. 
+ * @return A psuedo-random float.
+ */
+float randFloat(inout uint seed) {
+    return randInt(seed) / 4294967295.0; // 2^32 - 1
+}
+
+// https://stackoverflow.com/a/6178290
+/**
+ * Generates a normal-distributed psuedo-random float.
+ *
+ * @param seed The seed, which is changed after use. 
+ * @return A normal-distributed psuedo-random float.
+ */
+float randFloatNormDist(inout uint seed) {
+    float theta = 2 * PI * randFloat(seed);
+    float rho = sqrt(abs(-2 * log(randFloat(seed))));
+    return rho * cos(theta);
+}
+
+/**
+ * Generates a normal-distributed psuedo-random 2D vector.
+ *
+ * @param seed The seed, which is changed after use. 
+ * @return A normal-distributed psuedo-random vec2 for use in polar spaces.
+ */
+vec3 randVecNormDist(inout uint seed) {
+    float x = randFloatNormDist(seed),
+            y = randFloatNormDist(seed),
+            z = randFloatNormDist(seed);
+    return normalize(vec3(x, y, z));	
+}
+
+/**
+ * Geneates a normal-distributed psuedo-random 2D vector.
+ * While randVecNormDist() generates a normal-distribution for polar coordinates, this function does so for a square (cartesian space). 
+ *
+ * @param seed The seed, which is changed after use. 
+ * @return A normal-distributed psuedo-random vec2 for use in cartesian spaces.
+ */
+vec2 randVecCartesianNormDist(inout uint seed) {
+    float ang = randFloat(seed) * 2 * PI;
+    vec2 pos = vec2(cos(ang), sin(ang));
+    return pos * sqrt(abs(randFloatNormDist(seed))); // Normal distribution
+}
+
+// --- Environment functions ---
+vec3 CartesianToSpherical(vec3 cartesian) {
+	return vec3 (
+		sqrt(cartesian.x*cartesian.x + cartesian.y*cartesian.y + cartesian.z*cartesian.z),
+		atan(cartesian.y / cartesian.x),
+		atan(sqrt(cartesian.x*cartesian.x + cartesian.y*cartesian.y)/cartesian.z)
+	);
+}
+
+/**
+ * Gets the environment light where a ray goes.
+ *
+ * @param ray The ray.
+ * @return The environment light for the ray. 
+ */
+vec3 GetEnvironmentLight(Ray ray) {
+	vec2 uv = CartesianToSpherical(ray.dir).yz/PI-vec2(0.5,0.5) + vec2(frame.frameNumber, frame.frameNumber / 3.f) / 1800.f;
+    vec3 col = texture(imageSampler, uv).rgb; float col_m = length(col); if (col_m > 0.f) col /= col_m;
+    return col * pow(col_m, 3);
+}
+
+
+vec4 iTorus( in vec3 ro, in vec3 rd, in vec2 tor )
+{
+    float po = 1.0;
+    
+    float Ra2 = tor.x*tor.x;
+    float ra2 = tor.y*tor.y;
+	
+    float m = dot(ro,ro);
+    float n = dot(ro,rd);
+
+    // bounding sphere
+    {
+        float h = n*n - m + (tor.x+tor.y)*(tor.x+tor.y);
+        if( h<0.0 ) return vec4(-1.0);
+    }
+
+    // find quartic equation
+    float k = (m - ra2 - Ra2)/2.0;
+    float k3 = n;
+    float k2 = n*n + Ra2*rd.z*rd.z + k;
+    float k1 = k*n + Ra2*ro.z*rd.z;
+    float k0 = k*k + Ra2*ro.z*ro.z - Ra2*ra2;
+	
+#if 1
+    // prevent |c1| from being too close to zero
+    if( abs(k3*(k3*k3 - k2) + k1) < 0.01 )
+    {
+        po = -1.0;
+        float tmp=k1; k1=k3; k3=tmp;
+        k0 = 1.0/k0;
+        k1 = k1*k0;
+        k2 = k2*k0;
+        k3 = k3*k0;
+    }
+#endif
+
+    float c2 = 2.0*k2 - 3.0*k3*k3;
+    float c1 = k3*(k3*k3 - k2) + k1;
+    float c0 = k3*(k3*(-3.0*k3*k3 + 4.0*k2) - 8.0*k1) + 4.0*k0;
+
+    c2 /= 3.0;
+    c1 *= 2.0;
+    c0 /= 3.0;
+    
+    float Q = c2*c2 + c0;
+    float R = 3.0*c0*c2 - c2*c2*c2 - c1*c1;
+    
+    float h = R*R - Q*Q*Q;
+    float z = 0.0;
+    if( h < 0.0 )
+    {
+        // 4 intersections
+        float sQ = sqrt(Q);
+        z = 2.0*sQ*cos( acos(R/(sQ*Q)) / 3.0 );
+    }
+    else
+    {
+        // 2 intersections
+        float sQ = pow( sqrt(h) + abs(R), 1.0/3.0 );
+        z = sign(R)*abs( sQ + Q/sQ );
+    }		
+    z = c2 - z;
+	
+    float d1 = z   - 3.0*c2;
+    float d2 = z*z - 3.0*c0;
+    if( abs(d1) < 1.0e-4 )
+    {
+        if( d2 < 0.0 ) return vec4(-1.0);
+        d2 = sqrt(d2);
+    }
+    else
+    {
+        if( d1 < 0.0 ) return vec4(-1.0);
+        d1 = sqrt( d1/2.0 );
+        d2 = c1/d1;
+    }
+
+    //----------------------------------
+	
+    float result = 1e20;
+
+    h = d1*d1 - z + d2;
+    if( h > 0.0 )
+    {
+        h = sqrt(h);
+        float t1 = -d1 - h - k3; t1 = (po<0.0)?2.0/t1:t1;
+        float t2 = -d1 + h - k3; t2 = (po<0.0)?2.0/t2:t2;
+        if( t1 > 0.0 ) result=t1; 
+        if( t2 > 0.0 ) result=min(result,t2);
+    }
+
+    h = d1*d1 - z - d2;
+    if( h > 0.0 )
+    {
+        h = sqrt(h);
+        float t1 = d1 - h - k3;  t1 = (po<0.0)?2.0/t1:t1;
+        float t2 = d1 + h - k3;  t2 = (po<0.0)?2.0/t2:t2;
+        if( t1 > 0.0 ) result=min(result,t1);
+        if( t2 > 0.0 ) result=min(result,t2);
+    }
+
+    // Compute world-space position
+    vec3 world_pos = ro + result * rd;
+    return vec4(world_pos, result);
+}
+
+vec3 nTorus( in vec3 pos, vec2 tor )
+{
+	return normalize( pos*(dot(pos,pos)- tor.y*tor.y - tor.x*tor.x*vec3(1.0,1.0,-1.0)));
+}
+
+mat3 rotateEuler(vec3 angles) {
+    float cx = cos(angles.x);
+    float sx = sin(angles.x);
+    float cy = cos(angles.y);
+    float sy = sin(angles.y);
+    float cz = cos(angles.z);
+    float sz = sin(angles.z);
+
+    mat3 rx = mat3(
+        1.0, 0.0, 0.0,
+        0.0, cx, -sx,
+        0.0, sx, cx
+    );
+
+    mat3 ry = mat3(
+        cy, 0.0, sy,
+        0.0, 1.0, 0.0,
+        -sy, 0.0, cy
+    );
+
+    mat3 rz = mat3(
+        cz, -sz, 0.0,
+        sz, cz, 0.0,
+        0.0, 0.0, 1.0
+    );
+
+    return rz * ry * rx;
+}
+
+HitInfo RayTorus(Ray ray, RTTorus torus) {
+    HitInfo hitInfo = HitInfo0;
+    hitInfo.didHit = false;
+
+
+    vec3 rotEuler = torus.rotation_thickness.xyz + vec3( sin(frame.frameNumber / 50.f) / 10.f, cos(frame.frameNumber / 50.f) / 10.f, 0.f );
+    mat3 rot = rotateEuler( rotEuler ),
+         rotInv = transpose( rot );
+    mat3 scale = mat3(
+        1.0, 0.0, 0.0,
+        0.0, 1.0, 0.0,
+        0.0, 0.0, 0.5 );
+    mat3 scaleInv = transpose( scale );
+
+    vec3 ro = ray.origin,
+         rd = ray.dir;
+
+    ro = scaleInv * rotInv * (ro - torus.position_radius.xyz);
+    rd = scaleInv * rotInv * rd;
+
+    vec2    trus = vec2(torus.position_radius.w, torus.rotation_thickness.w) * 2.f;
+    vec4    result = iTorus( ro, rd, trus );
+    float   t = result.w;
+    vec3    pos = result.xyz;
+
+    if ( t > 0.0 ){
+
+		vec3 nor = nTorus( pos, trus );
+        hitInfo.didHit = true;
+        hitInfo.pos = torus.position_radius.xyz + scaleInv * rot * pos;
+        //hitInfo.dist = distance(hitInfo.pos, ray.origin);
+        hitInfo.dist = distance(pos, ro);
+        hitInfo.normal = nor;
+        //hitInfo.material = torus.material;
+
+        vec2 uv = CartesianToSpherical(hitInfo.pos).yz/PI-vec2(0.5,0.5) + vec2(frame.frameNumber, frame.frameNumber / 3.f) / 1800.f;
+        vec3 col = texture(imageSampler, uv).rgb; float col_m = length(col); if (col_m > 0.f) col /= col_m;
+        col = col * pow(col_m, 2) * 100.f * vec3(1.0,0.7,0.3) + vec3(0.5,0.2,0.1);
+        hitInfo.material = RTMaterial(vec4(col, 0.2), vec4(col,1), vec4(0,0,0,0), 0.f);
+
+
+    }
+
+    return hitInfo;
+}
+
+
+// --- Ray intersection functions ---
+/**
+ * Gets the position along a ray's (possibly curved) segment.
+ *
+ * @param ray The ray.
+ * @param t The distance along the segment.
+ * @return The position.
+ */
+vec3 ArcPoint(Ray ray, float t) {
+    return ray.origin + ray.dir * t + 0.5 * ray.accel * t * t;
+}
+
+/**
+ * Checks for an intersection between a ray and a sphere.
+ * For curved segments, the quartic is first solved to second order and then refined with Newton iterations.
+ *
+ * @param ray The ray.
+ * @param sphere The sphere.
+ *
+ * @return The hit information from the (possible) intersection.
+ */
+HitInfo RaySphere(Ray ray, RTSphere sphere) {
+    HitInfo hitInfo = HitInfo0;
+    vec3 offsetRayOrigin = ray.origin - sphere.center,
+         halfAccel = 0.5 * ray.accel;
+    float radiusSqr = sphere.radius*sphere.radius;
+
+    // Solve for distance with a quadratic equation
+    // (The arc's t^3 and t^4 terms are left out here)
+    float a = dot(ray.dir, ray.dir) + 2 * dot(offsetRayOrigin, halfAccel);
+    float b = 2 * dot(offsetRayOrigin, ray.dir);
+    float c = dot(offsetRayOrigin, offsetRayOrigin) - radiusSqr;
+    if (a <= kEpsilion) a = dot(ray.dir, ray.dir);
+
+    // Quadratic discriminant
+    float discriminant = b * b - 4 * a * c; 
+
+    // If d > 0, the ray intersects the sphere => calculate hitinfo
+    if (discriminant >= 0) {
+        float dist = (-b - sqrt(abs(discriminant))) / (2 * a);
+        if (!CULL_FACE && dist < 0) dist = (-b + sqrt(abs(discriminant))) / (2 * a);
+
+        // Refine the distance onto the arc, rejecting it if the iterations did not converge
+        if (ray.accel != vec3(0)) {
+            vec3 offset;
+            for (int i = 0; i < ARC_NEWTON_ITERATIONS; i++) {
+                offset = offsetRayOrigin + ray.dir * dist + halfAccel * dist * dist;
+                float derivative = 2 * dot(offset, ray.dir + ray.accel * dist);
+                if (derivative == 0) break;
+                dist -= (dot(offset, offset) - radiusSqr) / derivative;
+            }
+            offset = offsetRayOrigin + ray.dir * dist + halfAccel * dist * dist;
+            if (abs(dot(offset, offset) - radiusSqr) > 0.01 * radiusSqr) return hitInfo;
+        }
+
+        // (If the intersection happens behind the ray, ignore it)
+        if (dist >= 0) {
+            hitInfo.didHit = true;
+            hitInfo.dist = dist;
+            hitInfo.pos = ArcPoint(ray, dist);
+            hitInfo.normal = normalize(hitInfo.pos - sphere.center);
+            if (!CULL_FACE && dot(hitInfo.normal, ray.dir) > 0) hitInfo.normal = -hitInfo.normal;
+            //hitInfo.material = RTMaterial(vec4(hitInfo.pos,1), vec4(0,0,0,0), vec4(0,0,0,0), 0.f);
+            hitInfo.material = sphere.material;
+        }
+    }
+
+    // Otherwise, ray does not intersect sphere => return blank hitinfo
+    return hitInfo;
+}
+
+/**
+ * Checks for an intersection between a ray segment and a thin disk (annulus).
+ * The disk is detected by the sign of the distance to its plane changing between the
+ * segment's start and end, so only a dot product is needed for segments that do not cross it.
+ * Along a curved segment the plane distance is quadratic, so the crossing is solved exactly.
+ *
+ * @param ray The ray.
+ * @param disk The disk.
+ * @param stepDist The length of the segment.
+ *
+ * @return The hit information from the (possible) intersection.
+ */
+HitInfo RayDisk(Ray ray, RTDisk disk, float stepDist) {
+    HitInfo hitInfo = HitInfo0;
+    vec3    normal = normalize(disk.normal_outerRadius.xyz),
+            center = disk.center_innerRadius.xyz;
+
+    // Signed plane distance along the segment: a*t^2 + b*t + c
+    float   a = 0.5 * dot(ray.accel, normal),
+            b = dot(ray.dir, normal),
+            c = dot(ray.origin - center, normal),
+            endDist = (a * stepDist + b) * stepDist + c;
+
+    // (An arc can only cross the plane twice if it turns within the segment)
+    float   turn = a != 0 ? -b / (2 * a) : -1;
+    if (c * endDist > 0 && (turn <= 0 || turn >= stepDist)) return hitInfo;
+
+    // Find the first crossing point
+    float dist = -1;
+    if (abs(a) < 1e-6) {
+        if (b != 0) dist = -c / b;
+    } else {
+        float discriminant = b * b - 4 * a * c;
+        if (discriminant < 0) return hitInfo;
+        float   root0 = (-b - sqrt(discriminant)) / (2 * a),
+                root1 = (-b + sqrt(discriminant)) / (2 * a);
+        dist = min(root0, root1) >= kEpsilion ? min(root0, root1) : max(root0, root1);
+    }
+
+    // Check that it lies within the segment and annulus
+    vec3    pos = ArcPoint(ray, dist);
+    float   r = distance(pos, center),
+            rate = b + 2 * a * dist;
+    if (dist < kEpsilion || dist > stepDist || r < disk.center_innerRadius.w || r > disk.normal_outerRadius.w) return hitInfo;
+
+    hitInfo.didHit = true;
+    hitInfo.dist = dist;
+    hitInfo.pos = pos;
+    hitInfo.normal = rate > 0 ? -normal : normal;
+    hitInfo.material = disk.material;
+
+    // Emission profile, optionally modulated by the skybox texture for some variation along the disk
+    float emission = pow(disk.center_innerRadius.w / r, disk.profile.x);
+    if (disk.profile.y > 0.f) {
+        vec2 uv = CartesianToSpherical(pos - center).yz/PI-vec2(0.5,0.5) + vec2(r * 0.1f, frame.frameNumber / 1800.f);
+        emission *= mix(1.f, length(texture(imageSampler, uv).rgb), disk.profile.y);
+    }
+    hitInfo.material.emissionColor.w *= emission;
+
+    return hitInfo;
+}
+
+/**
+ * Checks for an intersection between a ray and a bounding box.
+ * Thanks to:   https://gist.github.com/DomNomNom/46bb1ce47f68d255fd5d
+ *              https://alain.xyz/blog/ray-tracing-acceleration-structures
+ *
+ * @param ray The ray.
+ * @param boxMin The bottom left corner of the box.
+ * @param boxMax The top right corner of the box.
+ *
+ * @return If the ray intersects the box at all.
+ */
+bool RayBoundingBox(Ray ray, vec3 boxMin, vec3 boxMax) {
+    vec3    rayDirInverted = 1.0 / ray.dir,
+            boxMinRelative = (boxMin - ray.origin) * rayDirInverted,
+            boxMaxRelative = (boxMax - ray.origin) * rayDirInverted,
+            boxMinNew = min( boxMinRelative, boxMaxRelative ),
+            boxMaxNew = max( boxMinRelative, boxMaxRelative );
+    
+    float   maxMinAxis = max( max( boxMinNew.x, boxMinNew.y ), boxMinNew.z ),
+            minMaxAxis = min( min( boxMaxNew.x, boxMaxNew.y ), boxMaxNew.z );
+
+    return maxMinAxis <= minMaxAxis;
+}
+
+// --- SDF functions ---
+/**
+ * Gets the signed distance from a point to a single SDF primitive.
+ *
+ * @param node The primitive node.
+ * @param pos The point.
+ * @return The signed distance.
+ */
+float SdfPrimitive(RTSdfNode node, vec3 pos) {
+    vec3    p = pos - node.position.xyz;
+    vec4    params = node.params;
+
+    switch (node.type) {
+        case RT_SDF_SPHERE:
+            return length(p) - params.x;
+        case RT_SDF_BOX: {
+            vec3 q = abs(p) - params.xyz + params.w;
+            return length(max(q, 0.0)) + min(max(q.x, max(q.y, q.z)), 0.0) - params.w;
+        }
+        case RT_SDF_TORUS:
+            return length(vec2(length(p.xz) - params.x, p.y)) - params.y;
+        case RT_SDF_CAPSULE: {
+            float h = clamp(dot(p, params.xyz) / dot(params.xyz, params.xyz), 0.0, 1.0);
+            return length(p - params.xyz * h) - params.w;
+        }
+    }
+    return 1e9;
+}
+
+/**
+ * Evaluates the CSG tree of an SDF object at a point.
+ * The nodes are stored in postfix order, so a small stack is enough.
+ *
+ * @param object The object.
+ * @param pos The point.
+ * @return The signed distance to the object's surface.
+ */
+float SdfObjectDistance(RTSdfObject object, vec3 pos) {
+    float   stack[RT_SDF_MAX_STACK];
+    int     top = 0;
+
+    for (uint i = object.nodeStart; i < object.nodeStart + object.nodeCount; i++) {
+        RTSdfNode node = sdfNodesIn[i];
+
+        // Primitives
+        if (node.type < RT_SDF_UNION) {
+            if (top < RT_SDF_MAX_STACK) stack[top++] = SdfPrimitive(node, pos);
+            continue;
+        }
+
+        // Operations
+        if (top < 2) break;
+        float   b = stack[--top],
+                a = stack[top - 1];
+        switch (node.type) {
+            case RT_SDF_UNION:      a = min(a, b); break;
+            case RT_SDF_INTERSECT:  a = max(a, b); break;
+            case RT_SDF_SUBTRACT:   a = max(a, -b); break;
+            case RT_SDF_SMOOTH_UNION: {
+                float h = clamp(0.5 + 0.5 * (b - a) / node.params.x, 0.0, 1.0);
+                a = mix(b, a, h) - node.params.x * h * (1.0 - h);
+                break;
+            }
+        }
+        stack[top - 1] = a;
+    }
+
+    return top > 0 ? stack[0] : 1e9;
+}
+
+/**
+ * Gets the surface normal of an SDF object using the tetrahedron technique (4 evaluations).
+ * Thanks to:   https://iquilezles.org/articles/normalsSDF/
+ *
+ * @param object The object.
+ * @param pos A point on the surface.
+ * @return The surface normal.
+ */
+vec3 SdfObjectNormal(RTSdfObject object, vec3 pos) {
+    const vec2 k = vec2(1, -1) * SDF_HIT_EPSILON;
+    return normalize(
+        k.xyy * SdfObjectDistance(object, pos + k.xyy) +
+        k.yyx * SdfObjectDistance(object, pos + k.yyx) +
+        k.yxy * SdfObjectDistance(object, pos + k.yxy) +
+        k.xxx * SdfObjectDistance(object, pos + k.xxx)
+    );
+}
+
+/**
+ * Checks for an intersection between a ray segment and an SDF object by sphere tracing.
+ * The march is clipped to the object's bounding sphere and to the segment,
+ * so far away from a surface a single bounds test is all a segment costs.
+ *
+ * @param ray The ray.
+ * @param object The object.
+ * @param stepDist The length of the segment.
+ *
+ * @return The hit information from the (possible) intersection.
+ */
+HitInfo RaySdf(Ray ray, RTSdfObject object, float stepDist) {
+    HitInfo hitInfo = HitInfo0;
+    float   maxDist = min(stepDist, SDF_MAX_DIST),
+            accel = length(ray.accel),
+            speed = 1.0 + accel * maxDist, // (Upper bound on how fast a curved segment moves per unit t)
+            boundsRadius = object.bounds.w + 0.5 * accel * maxDist * maxDist;
+
+    // Clip the march against the bounding sphere, grown by the segment's sag
+    vec3    offset = ray.origin - object.bounds.xyz;
+    float   b = dot(offset, ray.dir),
+            c = dot(offset, offset) - boundsRadius * boundsRadius,
+            discriminant = b * b - c;
+    if (discriminant < 0) return hitInfo;
+
+    float   tEnter = max(-b - sqrt(discriminant), 0.0),
+            tExit = min(-b + sqrt(discriminant), maxDist);
+
+    // Sphere trace along the segment
+    float t = tEnter;
+    for (int i = 0; i < SDF_MAX_STEPS && t <= tExit; i++) {
+        vec3    pos = ArcPoint(ray, t);
+        float   dist = SdfObjectDistance(object, pos);
+
+        if (dist < SDF_HIT_EPSILON) {
+            // (Move the hit point out of the surface, so the bounced ray does not hit it again immediately)
+            hitInfo.didHit = true;
+            hitInfo.dist = t;
+            hitInfo.normal = SdfObjectNormal(object, pos);
+            hitInfo.pos = pos + hitInfo.normal * 2 * SDF_HIT_EPSILON;
+            hitInfo.material = object.material;
+            return hitInfo;
+        }
+        t += dist / speed;
+    }
+
+    return hitInfo;
+}
+
+// --- Volume functions ---
+/**
+ * Checks whether a cell in the volume occupancy grid contains any density.
+ *
+ * @param cell The grid cell.
+ * @return Whether the cell is occupied.
+ */
+bool VolumeCellOccupied(ivec3 cell) {
+    uint bit = uint(cell.x + RT_VOLUME_GRID_SIZE * (cell.y + RT_VOLUME_GRID_SIZE * cell.z));
+    return (volumeOccupancy[bit / 32] & (1u << (bit % 32))) != 0;
+}
+
+/**
+ * Integrates the emission and absorption of every volume along a ray segment.
+ * Empty occupancy grid cells are skipped in a single step,
+ * and the ray is destroyed once its transmittance becomes negligible.
+ *
+ * @param ray The ray, at the start of the segment.
+ * @param segmentDist The length of the segment.
+ */
+void IntegrateVolumes(inout Ray ray, float segmentDist, inout vec3 incomingLight, inout vec3 rayColor, inout uint seed) {
+    for (int i = 0; i < ubo.volumesCount; i++) {
+        RTVolume volume = volumesIn[i];
+        vec3    boxMin = volume.boxMin_density.xyz,
+                boxSize = volume.boxMax_emission.xyz - boxMin;
+
+        // Clip the segment against the volume's box
+        // (Curved segments deviate at most 0.5*|accel|*dist^2 from their tangent, so the box is grown by that much)
+        float   sag = 0.5 * length(ray.accel) * segmentDist * segmentDist;
+        vec3    rayDirInverted = 1.0 / ray.dir,
+                boxMinRelative = (boxMin - sag - ray.origin) * rayDirInverted,
+                boxMaxRelative = (boxMin + boxSize + sag - ray.origin) * rayDirInverted,
+                boxMinNew = min( boxMinRelative, boxMaxRelative ),
+                boxMaxNew = max( boxMinRelative, boxMaxRelative );
+        float   tEnter = max( max( max( boxMinNew.x, boxMinNew.y ), boxMinNew.z ), 0.f ),
+                tExit = min( min( min( boxMaxNew.x, boxMaxNew.y ), boxMaxNew.z ), segmentDist );
+        if (tEnter >= tExit) continue;
+
+        // March through the box, jittering the first sample to avoid banding
+        // (The samples are spread out to cover the whole clipped segment, and each empty cell costs one more iteration)
+        vec3    cellSize = boxSize / RT_VOLUME_GRID_SIZE;
+        float   sampleDist = max( min( cellSize.x, min( cellSize.y, cellSize.z ) ) / VOLUME_SAMPLES_PER_CELL, (tExit - tEnter) / VOLUME_MAX_SAMPLES ),
+                t = tEnter + sampleDist * randFloat(seed);
+
+        for (int j = 0; j < VOLUME_MAX_SAMPLES + 3 * RT_VOLUME_GRID_SIZE && t < tExit; j++) {
+            vec3    pos = ArcPoint(ray, t),
+                    uvwUnclamped = (pos - boxMin) / boxSize,
+                    uvw = clamp( uvwUnclamped, 0.0, 1.0 );
+            ivec3   cell = min( ivec3(uvw * RT_VOLUME_GRID_SIZE), ivec3(RT_VOLUME_GRID_SIZE - 1) );
+
+            // (Parts of a curved segment may still lie outside the box)
+            if (uvw != uvwUnclamped) {
+                t += sampleDist;
+                continue;
+            }
+
+            // Skip empty cells entirely, leaving along the local tangent
+            if (!VolumeCellOccupied(cell)) {
+                vec3    tangentInverted = 1.0 / (ray.dir + ray.accel * t),
+                        cellMin = boxMin + vec3(cell) * cellSize,
+                        cellExit = max( (cellMin - pos) * tangentInverted, (cellMin + cellSize - pos) * tangentInverted );
+                t += max( min( min( cellExit.x, cellExit.y ), cellExit.z ), 0.0 ) + kEpsilion;
+                continue;
+            }
+
+            // Emission and absorption over the sample interval
+            vec4    texel = texture(volumeSampler, uvw);
+            float   dt = min( sampleDist, tExit - t ),
+                    absorbed = 1.0 - exp( -texel.a * volume.boxMin_density.w * dt );
+            incomingLight += texel.rgb * volume.boxMax_emission.w * absorbed * rayColor;
+            rayColor *= 1.0 - absorbed;
+            t += dt;
+
+            // Early exit once (almost) no light makes it through
+            if (max(rayColor.r, max(rayColor.g, rayColor.b)) < VOLUME_MIN_TRANSMITTANCE) {
+                ray.destroyed = true;
+                return;
+            }
+        }
+    }
+}
+
+// --- Raytracing functions ---
+/**
+ * Gets the straight ray from the start to the end of a (possibly curved) segment.
+ *
+ * @param ray The ray.
+ * @param stepDist The length of the segment.
+ * @return The chord.
+ */
+Ray ChordRay(Ray ray, float stepDist) {
+    Ray chord = ray;
+    chord.accel = vec3(0);
+    if (ray.accel != vec3(0) && stepDist < 1e8) chord.dir = normalize(ArcPoint(ray, stepDist) - ray.origin);
+    return chord;
+}
+
+HitInfo CalculateRayCollision(Ray ray, float stepDist) {
+    HitInfo closestHit = HitInfo0;
+    closestHit.dist = -1;
+
+    // Raycast toruses
+    // (The quartic solver only handles straight rays, so curved segments use their chord)
+    Ray chord = ChordRay(ray, stepDist);
+    for (int i = 0; HAS_TORI && i < ubo.torusCount; i++) {
+        RTTorus torus = torusIn[i];
+
+        HitInfo hitInfo = RayTorus(chord, torus);
+        if (hitInfo.didHit && hitInfo.dist <= stepDist && ( closestHit.dist < 0 || hitInfo.dist < closestHit.dist ) )
+        {
+            closestHit = hitInfo;
+            closestHit.id = RT_PRIMITIVE_ID( RT_PRIMITIVE_TORUS, i );
+        }
+    }
+
+    // Raycast disks
+    for (int i = 0; i < ubo.disksCount; i++) {
+        RTDisk disk = disksIn[i];
+
+        HitInfo hitInfo = RayDisk(ray, disk, stepDist);
+        if (hitInfo.didHit && ( closestHit.dist < 0 || hitInfo.dist < closestHit.dist ) )
+        {
+            closestHit = hitInfo;
+            closestHit.id = RT_PRIMITIVE_ID( RT_PRIMITIVE_DISK, i );
+        }
+    }
+
+    // Raycast SDF objects
+    for (int i = 0; i < ubo.sdfObjectsCount; i++) {
+        RTSdfObject object = sdfObjectsIn[i];
+
+        HitInfo hitInfo = RaySdf(ray, object, closestHit.dist < 0 ? stepDist : closestHit.dist);
+        if (hitInfo.didHit && ( closestHit.dist < 0 || hitInfo.dist < closestHit.dist ) )
+        {
+            closestHit = hitInfo;
+            closestHit.id = RT_PRIMITIVE_ID( RT_PRIMITIVE_SDF, i );
+        }
+    }
+
+    // Raycast spheres
+    for (int i = 0; HAS_SPHERES && i < ubo.spheresCount; i++) {
+        RTSphere sphere = spheresIn[i];
+
+        HitInfo hitInfo = RaySphere(ray, sphere);
+        if (hitInfo.didHit && hitInfo.dist <= stepDist && ( closestHit.dist < 0 || hitInfo.dist < closestHit.dist ) )
+        {
+            closestHit = hitInfo;
+            closestHit.id = RT_PRIMITIVE_ID( RT_PRIMITIVE_SPHERE, i );
+        }
+    }
+
+    // Return the collision which occured closest to the origin
+    return closestHit;
+}
+
+/**
+ * Samples a ray segment, bouncing off anything it hits along the way.
+ *
+ * @return Whether anything was hit.
+ */
+bool SampleLineSegment(inout Ray ray, inout float stepDist, inout vec3 incomingLight, inout vec3 rayColor, inout uint seed) {
+    bool didHit = false;
+    while ( stepDist > 0.f ) {
+        // Check for ray intersection between current position and predicted
+        HitInfo hitInfo = CalculateRayCollision(ray, stepDist);
+
+        // Integrate participating media up to the intersection (or end of segment)
+        if ( ubo.volumesCount > 0 ) {
+            IntegrateVolumes(ray, hitInfo.didHit ? hitInfo.dist : stepDist, incomingLight, rayColor, seed);
+            if (ray.destroyed) return didHit;
+        }
+
+        if ( hitInfo.didHit ) {
+            didHit = true;
+            if (firstHit.w == RT_HIT_NONE) {
+                firstHit = vec4( hitInfo.pos, RT_HIT_STRAIGHT );
+                firstHitDir = normalize(ray.dir + ray.accel * hitInfo.dist);
+                firstHitNormal = vec4( hitInfo.normal, hitInfo.id );
+            }
+
+            // Update stepdist and ray
+            // (The rest of the segment is straight, starting from the arc's tangent at the hit)
+            stepDist -= hitInfo.dist;
+            ray.origin = hitInfo.pos;
+            ray.dir = normalize(ray.dir + ray.accel * hitInfo.dist);
+            ray.accel = vec3(0);
+            RTMaterial material = hitInfo.material;
+
+            bool 	isSpecular  = material.specularColor.w >= randFloat(seed);
+            vec3 	specularDir = reflect(ray.dir, hitInfo.normal),
+                    diffuseDir  = normalize(hitInfo.normal + randVecNormDist(seed));
+            ray.dir = normalize(mix(diffuseDir, specularDir, material.smoothness * int(isSpecular)));
+
+            // Sample
+            vec3 emittedLight = material.emissionColor.xyz * material.emissionColor.w;
+            incomingLight += emittedLight * rayColor;
+            rayColor *= mix(material.color, material.specularColor, int(isSpecular)).rgb;
+
+            // Early exit if ray color ~= 0
+            // (Use some randomness to avoid "artificial" look)
+            float p = max(rayColor.r, max(rayColor.g, rayColor.b));
+            if (randFloat(seed) >= p) {
+                ray.destroyed = true;
+                return didHit;
+            }
+            rayColor *= 1.0f / p;
+        } else {
+            ray.origin = ArcPoint(ray, stepDist);
+            ray.dir = normalize(ray.dir + ray.accel * stepDist);
+            ray.accel = vec3(0);
+            stepDist -= stepDist;
+        }
+
+        if ( !HAS_HOLES || ubo.blackholesCount <= 0 ) return didHit;
+    }
+
+    return didHit;
+}
+
+/**
+ *  Gets the Schwarzschild radius (2 M) a black hole acts with in the relativistic metrics.
+ *  (There, RTParams::blackholePower scales the mass, so the horizon, steps and transfer tables grow with it)
+ */
+float BlackholeSchwarzschildRadius(RTBlackhole blackhole) {
+    return blackhole.radius * ubo.blackholePower;
+}
+
+/**
+ *  Calculates the acceleration a black hole applies to light at a given position.
+ */
+vec3 BlackholeAcceleration(vec3 pos, vec3 dir, RTBlackhole blackhole) {
+#if METRIC == METRIC_SCHWARZSCHILD || METRIC == METRIC_KERR
+    // Exact null geodesics in Schwarzschild coordinates, written as a central force: -3/2 rs h^2 x / r^5
+    vec3    offset = pos - blackhole.center,
+            angularMomentum = cross( offset, dir );
+    float   distSqr = dot( offset, offset ),
+            rs = BlackholeSchwarzschildRadius( blackhole );
+    vec3    accel = -1.5f * rs * dot( angularMomentum, angularMomentum ) * offset / (distSqr * distSqr * sqrt( distSqr ));
+
+#if METRIC == METRIC_KERR
+    // Weak-field frame dragging: 2 dir x (3 (J.r) r - J) / r^3, with J = spin M^2 axis
+    float   mass = 0.5f * rs,
+            dist = sqrt( distSqr );
+    vec3    offsetDir = offset / dist,
+            spin = blackhole.spinAxis_spin.xyz * (blackhole.spinAxis_spin.w * mass * mass / max( length( blackhole.spinAxis_spin.xyz ), 1e-6f ));
+    accel += 2.f * cross( dir, (3.f * dot( spin, offsetDir ) * offsetDir - spin) / (distSqr * dist) );
+#endif
+
+    return accel;
+#else
+    // Get direction and distance to the black hole
+    vec3    dirToHole = blackhole.center - pos;
+    float   dist = length( dirToHole ); dirToHole /= dist;
+    float   invDist = 1.f / dist;
+
+    // Calculate forces
+    // (Spin is left to the Kerr variant)
+    float   invDistSqr = invDist * invDist;
+    float   bendForce  = invDistSqr * ubo.blackholePower;
+
+    return dirToHole * bendForce;
+#endif
+}
+
+/**
+ *  Gets the radius within which light is captured by a black hole.
+ */
+float BlackholeHorizon(RTBlackhole blackhole) {
+#if METRIC == METRIC_KERR
+    float spin = clamp( blackhole.spinAxis_spin.w, 0.f, 0.999f );
+    return 0.5f * BlackholeSchwarzschildRadius( blackhole ) * (1.f + sqrt( 1.f - spin * spin ));
+#elif METRIC == METRIC_SCHWARZSCHILD
+    return BlackholeSchwarzschildRadius( blackhole );
+#else
+    return blackhole.radius;
+#endif
+}
+
+/**
+ *  Gets the step distance for a ray at a given distance from a black hole.
+ */
+float BlackholeStepDist(float dist, RTBlackhole blackhole, float randomFactor) {
+#if METRIC == METRIC_SCHWARZSCHILD || METRIC == METRIC_KERR
+    // (Bending grows quickly near the photon sphere, so the step shrinks towards the horizon)
+    return 0.1f * BlackholeSchwarzschildRadius( blackhole ) + randomFactor * RAY_STEP_FACTOR * (dist - BlackholeHorizon( blackhole ));
+#else
+    return 0.1f + randomFactor * RAY_STEP_FACTOR * dist;
+#endif
+}
+
+#if METRIC == METRIC_KERR
+/**
+ *  Gets the distance a ray can travel before entering a black hole's transfer table sphere.
+ */
+float KerrLUTEntryDist(Ray ray, RTBlackhole blackhole) {
+    float   radius = KERR_LUT_RADIUS * 0.5f * BlackholeSchwarzschildRadius( blackhole );
+    vec3    offset = ray.origin - blackhole.center;
+    float   b = dot( offset, ray.dir ),
+            c = dot( offset, offset ) - radius * radius,
+            discriminant = b * b - c;
+    if (c <= 0 || b >= 0 || discriminant <= 0) return 1e9;
+
+    // (Overshoot slightly, so the next step starts inside the sphere)
+    return -b - sqrt( discriminant ) + 0.01f * radius;
+}
+
+/**
+ *  Moves a ray which is entering a black hole's transfer table sphere straight to where it leaves it,
+ *  or destroys it if it is captured. Anything inside the sphere is skipped.
+ *  The tables are indexed by the incoming direction relative to the spin axis and the impact vector, see kerr.hpp.
+ *
+ *  @return Whether the tables were used.
+ */
+bool KerrTransfer(inout Ray ray, RTBlackhole blackhole) {
+    float   radius = KERR_LUT_RADIUS * 0.5f * BlackholeSchwarzschildRadius( blackhole );
+    vec3    offset = ray.origin - blackhole.center;
+    if (dot( offset, offset ) > radius * radius * 1.0404f || dot( offset, ray.dir ) >= 0) return false;
+
+    // Build the ray's local frame (u: spin axis perpendicular to the ray, d: the ray)
+    // (A hole without an axis does not spin, so any axis will do)
+    vec3    axis = blackhole.spinAxis_spin.xyz != vec3(0) ? normalize( blackhole.spinAxis_spin.xyz ) : vec3(0,1,0),
+            d = ray.dir,
+            u = axis - dot( axis, d ) * d;
+    u = dot( u, u ) > 1e-6 ? normalize( u ) : normalize( cross( d, abs( d.x ) < 0.9 ? vec3(1,0,0) : vec3(0,1,0) ) );
+    vec3    v = cross( d, u ),
+            impactVector = offset - dot( offset, d ) * d;
+
+    // Look up the transfer
+    float   psi = atan( dot( impactVector, v ), dot( impactVector, u ) ),
+            theta = acos( clamp( dot( d, axis ), -1.f, 1.f ) );
+    vec3    uvw = vec3( fract( psi / (2 * PI) ), min( length( impactVector ) / radius, 1.f ), theta / PI );
+    vec4    direction = textureLod( kerrDirectionSampler, uvw, 0 );
+    if (direction.a > 0.5f) {
+        ray.destroyed = true;
+        return true;
+    }
+
+    mat3 localToWorld = mat3( u, v, d );
+    ray.origin = blackhole.center + normalize( localToWorld * textureLod( kerrExitSampler, uvw, 0 ).xyz ) * radius;
+    ray.dir = normalize( localToWorld * direction.xyz );
+    return true;
+}
+#endif
+
+/**
+ *  Samples the refractive index of a medium and its gradient.
+ *
+ *  @return The gradient of n in xyz, and n in w (1 outside of the medium).
+ */
+vec4 MediumSample(RTMedium medium, vec3 pos) {
+    vec3    p = pos - medium.center_radius.xyz;
+    float   r = length(p),
+            R = medium.center_radius.w;
+    if (r >= R) return vec4(0, 0, 0, 1);
+
+    vec4 params = medium.params;
+    switch (medium.type) {
+        case RT_MEDIUM_TEXTURE: {
+            vec4 texel = textureLod( refractionSampler, p / (2 * R) + 0.5, 0 );
+            return vec4( texel.xyz * params.x / R, 1 + texel.w * params.x );
+        }
+        case RT_MEDIUM_LUNEBURG: {
+            float n = sqrt( 1 + params.x * (1 - r * r / (R * R)) );
+            return vec4( -params.x * p / (R * R * n), n );
+        }
+        case RT_MEDIUM_LINEAR:
+            return vec4( params.xyz, max( params.w + dot(params.xyz, p), 1.0 ) );
+        case RT_MEDIUM_SHELL: {
+            if (r <= params.x) return vec4(0, 0, 0, 1 + params.y);
+            float n1 = params.y * exp( -(r - params.x) / params.z );
+            return vec4( -n1 / params.z * p / r, 1 + n1 );
+        }
+    }
+    return vec4(0, 0, 0, 1);
+}
+
+/**
+ *  Calculates the acceleration of light from the black hole.
+ *  (Refractive media are sampled once per step instead, see MediaStep)
+ */
+vec3 LightAcceleration(vec3 pos, vec3 dir) {
+    vec3 accel = vec3(0);
+
+    // (For now, this assumes only ONE black hole exists.)
+    if (HAS_HOLES && ubo.blackholesCount > 0) accel += BlackholeAcceleration( pos, dir, blackholesIn[0] );
+
+    return accel;
+}
+
+/**
+ *  Gets the largest step a ray can take without skipping over, or taking too coarse steps through, a refractive medium,
+ *  and the acceleration the media apply at its origin. Each medium the ray is inside is sampled once.
+ *  Outside a medium, the ray may step up to its bounding sphere. Inside, the step is limited by the local gradient.
+ *
+ *  @param ray The ray.
+ *  @param accel Outputs the media's acceleration of the ray.
+ *  @param inMedium Outputs whether the ray is inside any medium.
+ *  @return The step limit, 1e9 if no medium is in the way.
+ */
+float MediaStep(Ray ray, out vec3 accel, out bool inMedium) {
+    float limit = 1e9;
+    accel = vec3(0);
+    inMedium = false;
+
+    for (int i = 0; i < ubo.mediaCount; i++) {
+        RTMedium medium = mediaIn[i];
+        vec3    offset = ray.origin - medium.center_radius.xyz;
+        float   R = medium.center_radius.w,
+                c = dot(offset, offset) - R * R;
+
+        if (c >= 0) {
+            // Only limit the step if the ray is heading into the medium
+            float   b = dot(offset, ray.dir),
+                    discriminant = b * b - c;
+            if (b < 0 && discriminant > 0) limit = min( limit, -b - sqrt(discriminant) + GRIN_MIN_STEP );
+        } else {
+            vec4 index = MediumSample( medium, ray.origin );
+            limit = min( limit, max( GRIN_STEP_SCALE * index.w / max( length(index.xyz), 1e-6 ), GRIN_MIN_STEP ) );
+            // (The ray equation of gradient-index optics: (grad n - (grad n . dir) dir) / n)
+            accel += (index.xyz - dot( index.xyz, ray.dir ) * ray.dir) / index.w;
+            inMedium = true;
+        }
+    }
+
+    return limit;
+}
+
+/**
+ *  Gets the strength of a black hole's weak-field (thin lens) deflection,
+ *  such that a ray passing at impact parameter b is deflected by 2 * strength / b in total.
+ */
+float ThinLensStrength(RTBlackhole blackhole) {
+#if METRIC == METRIC_SCHWARZSCHILD || METRIC == METRIC_KERR
+    return BlackholeSchwarzschildRadius( blackhole ); // (2 rs / b, i.e. 4 M / b)
+#else
+    return ubo.blackholePower;
+#endif
+}
+
+/**
+ *  Traces a ray as two straight segments, bent once at its closest approach to the black hole.
+ *  The bend is the weak-field deflection the ray would gather from its origin onwards:
+ *  (strength / b) * (1 + s / sqrt(b^2 + s^2)), where s is the distance to the closest approach.
+ *  Rays passing within previewFallbackRadius horizons, or hitting something before the bend, are left to regular stepping.
+ *
+ *  @return Whether the ray is done (escaped or destroyed).
+ */
+bool TraceThinLens(inout Ray ray, inout vec3 incomingLight, inout vec3 rayColor, inout uint seed) {
+    if (!HAS_HOLES || ubo.blackholesCount <= 0) return false;
+    RTBlackhole blackhole = blackholesIn[0];
+    float       fallbackRadius = ubo.previewFallbackRadius * BlackholeHorizon( blackhole );
+
+    // Find the closest approach of the straight ray
+    vec3    toHole = blackhole.center - ray.origin;
+    float   approachDist = dot( toHole, ray.dir );
+    vec3    impactVector = ray.origin + ray.dir * approachDist - blackhole.center;
+    float   impact = length( impactVector );
+    if (impact < fallbackRadius || length( toHole ) < fallbackRadius) return false;
+
+    float deflection = ThinLensStrength( blackhole ) / impact * (1.f + approachDist / sqrt( impact * impact + approachDist * approachDist ));
+
+    // Straight up to the closest approach
+    if (approachDist > 0) {
+        float stepDist = approachDist;
+        if (SampleLineSegment( ray, stepDist, incomingLight, rayColor, seed ) || ray.destroyed) return ray.destroyed;
+    }
+
+    // Bend, then straight out into space
+    ray.dir = normalize( ray.dir - impactVector / impact * deflection );
+    float stepDist = 1e9;
+    SampleLineSegment( ray, stepDist, incomingLight, rayColor, seed );
+    return true;
+}
+
+/**
+ *  Bends the light ray's direction and outputs the predicted step distance.
+ *  With curved segments, the acceleration is evaluated at the predicted midpoint of the step
+ *  and stored in the ray, so the segment becomes a parabolic arc rather than a straight line.
+ *
+ *  @param inMedium Outputs whether the step starts inside a refractive medium, whose steps have a budget of their own.
+ */
+float BendLight(inout Ray ray, inout uint seed, out bool inMedium) {
+    float   randomFactor = mix( 1.0-RAY_STEP_RANDOMNESS, 1.0/(1.0-RAY_STEP_RANDOMNESS), randFloat(seed) );
+    float   stepDist = 1e9;
+    inMedium = false;
+
+    for (int i = 0; HAS_HOLES && i < ubo.blackholesCount; i++) {
+        RTBlackhole blackhole = blackholesIn[i];
+
+#if METRIC == METRIC_KERR
+        // Close to a spinning hole, use the transfer tables instead of stepping
+        if (KerrTransfer( ray, blackhole ) && ray.destroyed) return -1.f;
+#endif
+        float dist = distance( blackhole.center, ray.origin );
+
+        // Destroy ray and return if it's too close to the black hole
+        if (dist < BlackholeHorizon( blackhole )) {
+            ray.destroyed = true;
+            return -1.f;
+        }
+
+        // Calculate step distance
+        // (For now, this assumes only ONE black hole exists.)
+        stepDist = BlackholeStepDist( dist, blackhole, randomFactor );
+#if METRIC == METRIC_KERR
+        stepDist = min( stepDist, KerrLUTEntryDist( ray, blackhole ) );
+#endif
+        break;
+    }
+
+    // Refractive media may require shorter steps
+    vec3 mediaAccel = vec3(0);
+    if (ubo.mediaCount > 0) stepDist = min( stepDist, randomFactor * MediaStep(ray, mediaAccel, inMedium) );
+    if (stepDist >= 1e9) return stepDist;
+
+    // Change direction of lightray
+    vec3 accel = LightAcceleration( ray.origin, ray.dir ) + mediaAccel;
+    if (CURVED_SEGMENTS) {
+        // (Only the hole is evaluated again at the midpoint, the media keep their gradient from the origin)
+        float   halfStep = 0.5f * stepDist;
+        vec3    midPos = ray.origin + ray.dir * halfStep + 0.5f * accel * halfStep * halfStep,
+                midDir = normalize( ray.dir + accel * halfStep );
+        accel = LightAcceleration( midPos, midDir ) + mediaAccel;
+        ray.accel = accel - dot( accel, ray.dir ) * ray.dir; // (Light only changes direction, not speed)
+    } else {
+        ray.dir = normalize( ray.dir + accel * stepDist );
+    }
+
+    return stepDist;
+}
+
+/**
+ *  Counts a step against a ray's budgets.
+ *  Steps inside refractive media are short, so they come out of GRIN_MAX_STEPS while it lasts, the rest out of RAY_SUBDIVISIONS.
+ *
+ *  @param inMedium Whether the step started inside a medium, see BendLight.
+ *  @param rayDivision The ray's regular steps so far.
+ *  @param grinSteps The ray's steps inside media so far.
+ */
+void CountStep(bool inMedium, inout int rayDivision, inout int grinSteps) {
+    if (inMedium && grinSteps < GRIN_MAX_STEPS) grinSteps++;
+    else rayDivision++;
+}
+
+vec3 Trace(Ray ray, inout uint seed) {
+    vec3 	incomingLight = vec3(0),
+            rayColor = vec3(1),
+            initialDir = ray.dir;
+    firstHit = vec4(0);
+    firstHitNormal = vec4(0);
+    
+    int rayDivision = 0,
+        grinSteps = 0;
+
+    // In preview mode, most rays are bent once analytically instead of stepped
+    if (ubo.previewMode != 0 && TraceThinLens(ray, incomingLight, rayColor, seed)) rayDivision = RAY_SUBDIVISIONS;
+
+    while (rayDivision < RAY_SUBDIVISIONS) {
+        // Create line segment from the current ray position to the predicted next one
+        bool inMedium;
+        float stepDist = BendLight(ray, seed, inMedium);
+        CountStep(inMedium, rayDivision, grinSteps);
+        if (ray.destroyed) break;
+        SampleLineSegment(ray, stepDist, incomingLight, rayColor, seed);
+        if (ray.destroyed) break;
+    }
+
+    // Classify the first hit, for reprojection
+    // (Hits reached along a bent path can't be reprojected as if seen along a straight line)
+    if (firstHit.w == RT_HIT_STRAIGHT && dot(firstHitDir, initialDir) < 0.999) firstHit.w = RT_HIT_BENT;
+    if (firstHit.w == RT_HIT_NONE) firstHit = ray.destroyed ? vec4( ray.origin, RT_HIT_CAPTURED ) : vec4( ray.dir, RT_HIT_ESCAPED );
+
+    // If the ray was not destroyed but instead went out into space, sample enironment color
+    // (Destroyed rays keep the light they gathered before being absorbed)
+    if (ray.destroyed) return incomingLight;
+    return incomingLight + GetEnvironmentLight(ray) * rayColor;
+}
+
+// --- Pixel functions ---
+/**
+ *  Generates a camera ray through a pixel, jittered by divergeStrength.
+ *
+ *  @param pixelId The pixel.
+ *  @param seed The seed, which is changed after use.
+ *  @return The ray.
+ */
+Ray CameraRay(uvec2 pixelId, inout uint seed) {
+    vec2 uv = vec2( pixelId.x / frame.traceSize.x, 1 - pixelId.y / frame.traceSize.y );
+
+    // Calculate focus point
+    float   planeHeight = ubo.focusDistance * tan(ubo.fov * 0.5 * PI / 180.0) * 2.0,
+            planeWidth = planeHeight * (frame.traceSize.x / frame.traceSize.y);
+    vec3    viewParams = vec3( planeWidth, planeHeight, ubo.focusDistance );
+
+    vec3    focusPointLocal = vec3(uv - 0.5, 1) * viewParams,
+            focusPoint = (frame.localToWorld * vec4(focusPointLocal, 1)).xyz,
+            camUp = normalize(frame.localToWorld[1].xyz),
+            camRight = normalize(frame.localToWorld[0].xyz);
+
+    // Calculate ray origin and dir
+    vec2 jitter = randVecCartesianNormDist(seed) * ubo.divergeStrength / frame.traceSize.x;
+    vec3 focusPointJittered = focusPoint + camRight*jitter.x + camUp*jitter.y;
+
+    Ray ray;
+    ray.origin = frame.cameraPos;
+    ray.dir = normalize(focusPointJittered - ray.origin);
+    ray.accel = vec3(0);
+    ray.destroyed = false;
+    return ray;
+}
+
+/**
+ *  Adds samples to a pixel's accumulated light, then outputs the pixel's average.
+ *
+ *  @param pixelId The pixel.
+ *  @param light The summed light of the samples.
+ *  @param samples The number of samples.
+ *  @param luminanceSqr The summed squared luminance of the samples.
+ */
+void AccumulatePixel(uvec2 pixelId, vec3 light, float samples, float luminanceSqr) {
+    ivec2   pixel = ivec2(pixelId);
+    vec4    accumulated = vec4( light, samples );
+    if (frame.accumulatedFrames > 0) {
+        accumulated += imageLoad(accumulationImage, pixel);
+        luminanceSqr += imageLoad(momentsImage, pixel).r;
+    }
+    imageStore(accumulationImage, pixel, accumulated);
+    imageStore(momentsImage, pixel, vec4( luminanceSqr ));
+
+    vec3 fragCol = accumulated.rgb / accumulated.a;
+    imageStore(image, pixel, vec4( fragCol, 1 ));
+}
+
+/**
+ *  Stores the first hit of a pixel for this frame.
+ *
+ *  @param pixelId The pixel.
+ *  @param hit The first hit, see RT_HIT_*.
+ *  @param normal The normal (xyz) and primitive id (w) of the first hit.
+ */
+void StoreFirstHit(uvec2 pixelId, vec4 hit, vec4 normal) {
+    uint parity = uint(frameState.frameNumber) & 1u; // (Of the frame, rather than of the wave, see wavefront.comp)
+    imageStore(hitImage, ivec2( pixelId.x, pixelId.y + parity * ubo.imageHeight ), hit);
+    imageStore(hitNormalImage, ivec2(pixelId), normal);
+}
+
+/**
+ *  Gets the size of the grid of cells covering the pixels of a tile traced this frame, see InterleavedOffset.
+ */
+uvec2 InterleavedCells() {
+    return uvec2( frame.interleave == 4 ? RT_TILE_SIZE / 2 : RT_TILE_SIZE, frame.interleave == 1 ? RT_TILE_SIZE : RT_TILE_SIZE / 2 );
+}
+
+/**
+ *  Finds the pixel of a tile traced this frame in a cell, see INTERLEAVE_SLOT.
+ *  (So kernels loop over the traced pixels only, rather than leaving lanes idle on the others)
+ *
+ *  @param cell The cell, within InterleavedCells().
+ *  @return The pixel's offset from the tile's corner.
+ */
+uvec2 InterleavedOffset(uvec2 cell) {
+    uint phase = frame.interleavePhase;
+    if (frame.interleave == 2) return uvec2( cell.x, 2 * cell.y + ((cell.x + phase) & 1) );
+    if (frame.interleave == 4) return 2 * cell + uvec2( (phase & 1) ^ (phase >> 1), phase & 1 );
+    return cell;
+}
+
+/**
+ *  Gets the share of this frame's rays a pixel gets.
+ *  Pixels whose first hit was bent (or captured) last frame, around the holes and their rings, get every ray.
+ *  Others get less the further they are from the fovea, scaled by the budget map.
+ *
+ *  @param pixelId The pixel.
+ *  @return The weight, in [budgetMin, 1].
+ */
+float SampleBudget(uvec2 pixelId) {
+    if (ubo.budgetEnabled == 0) return 1;
+
+    uint parity = (uint(frameState.frameNumber) & 1u) ^ 1u;
+    float previousHit = imageLoad(hitImage, ivec2( pixelId.x, pixelId.y + parity * ubo.imageHeight )).w;
+    if (previousHit == RT_HIT_BENT || previousHit == RT_HIT_CAPTURED) return 1;
+
+    vec2    uv = (vec2(pixelId) + 0.5) / frame.traceSize;
+    float   foveaDistance = length((uv - ubo.foveaCenter) * vec2( frame.traceSize.x / frame.traceSize.y, 1 )),
+            weight = 1 - smoothstep(ubo.foveaRadius, ubo.foveaRadius + ubo.foveaFalloff, foveaDistance);
+    ivec2   cell = min(ivec2(uv * RT_BUDGET_MAP_SIZE), ivec2(RT_BUDGET_MAP_SIZE - 1));
+    return max(weight * budgetMap[cell.y * RT_BUDGET_MAP_SIZE + cell.x], ubo.budgetMin);
+}
+
+/**
+ *  Traces all of this frame's rays through a pixel and accumulates them.
+ *
+ *  @param pixelId The pixel.
+ */
+void TracePixel(uvec2 pixelId) {
+    // Create seed for RNG
+    uint i = uint( pixelId.y * frame.traceSize.x + pixelId.x );
+    uint seed = i + frame.frameNumber * 719393;
+
+    // Fire rays
+    // (Its share of them, rounded at random so the expected count is exact, and at least one so the accumulation can restart)
+    vec3    totalIncomingLight = vec3(0);
+    float   totalLuminanceSqr = 0;
+    uint    rays = clamp(uint(frame.raysPerFrag * SampleBudget(pixelId) + randFloat(seed)), 1u, frame.raysPerFrag);
+
+    for ( int i = 0; i < rays; i++ )
+    {
+        Ray ray = CameraRay(pixelId, seed);
+        vec3 incomingLight = Trace(ray, seed);
+        if (i == 0) StoreFirstHit(pixelId, firstHit, firstHitNormal);
+        totalIncomingLight += incomingLight;
+        totalLuminanceSqr += Luminance(incomingLight) * Luminance(incomingLight);
+    }
+
+    // Accumulate, then return final color (average of all of the frag's rays so far)
+    AccumulatePixel(pixelId, totalIncomingLight, rays, totalLuminanceSqr);
+}
+
+#endif
@@ -1,11 +1,14 @@
 #version 450
 
-layout(location = 0) in vec2 textureCoordinate;
+#extension GL_GOOGLE_include_directive : enable
+
+#include "present.glsl"
 
-layout(binding = 0) uniform sampler2D imageSampler;
+layout(location = 0) in vec2 textureCoordinate;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = texture(imageSampler, textureCoordinate);
-}
\ No newline at end of file
+    // (The swapchain's SRGB format encodes the color)
+    outColor = vec4( PresentColor(textureCoordinate), 1.0 );
+}
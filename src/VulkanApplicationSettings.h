@@ -6,9 +6,74 @@
 #include <cstdint> // uint32_t
 #include <vector>
 
+#include "metric.hpp"
+#include "glsl_cpp_common.h"
+
 static const uint32_t  WIDTH = 1152;
 static const uint32_t  HEIGHT = 768;
-static const int       MAX_FRAMES_IN_FLIGHT = 2;
+
+// Frames in flight, and swapchain images, set at startup from the config file and the command line (see settings.cpp)
+// (Every per-frame resource is sized by framesInFlight, so 1, 2 or 3 can be compared without recompiling)
+static const char*     RUNTIME_CONFIG_PATH = "../resources/settings.cfg";
+static const uint32_t  MAX_FRAMES_IN_FLIGHT = 8;
+inline uint32_t        framesInFlight = 2;
+inline uint32_t        swapchainImageCount = 0; // 0 asks for one more than the surface's minimum
+
+void loadRuntimeSettings(int argc, char** argv);
+
+// Metric used by the compute shader variant (and any CPU tracing), see metric.hpp
+// (Use KerrMetric to render frame dragging around spinning holes, its transfer tables are cached in resources/cache)
+using ActiveMetric = NewtonianMetric;
+
+// How the compute shader traces rays
+// Megakernel: one invocation traces a pixel from start to finish (shader.comp)
+// Wavefront: rays move between small bend/intersect/shade kernels through GPU queues (wavefront.comp), which keeps lanes busy in divergent views
+// Persistent: a fixed number of workgroups pull batches of pixels from a global counter (persistent.comp), so expensive pixels don't leave cores idle at the end of a frame
+enum class TraceMode { Megakernel, Wavefront, Persistent };
+static const TraceMode TRACE_MODE = TraceMode::Megakernel;
+static const uint32_t  WAVEFRONT_ITERATIONS = 24; // Most bend/intersect/shade rounds per wave, rays still in flight after these are resolved as escaped
+static const uint32_t  WAVEFRONT_ROUND_MARGIN = 4; // Rounds recorded beyond the most any wave needed recently (see readWavefrontRounds)
+static const uint32_t  PERSISTENT_WORKGROUPS_PER_CORE = 4; // Workgroups launched per multiprocessor (SM/CU)
+static const uint32_t  PERSISTENT_FALLBACK_CORES = 64; // Assumed multiprocessor count, for devices which don't report it
+
+// Trace kernel tuning, applied as specialization constants (see specialization.hpp)
+static const int32_t   TRACE_RAY_SUBDIVISIONS = 8;
+static const bool      TRACE_CULL_FACE = true;
+static const float     TRACE_RAY_STEP_RANDOMNESS = 0.025f;
+static const uint32_t  TRACE_GROUP_SIZE = 32; // Must divide RT_TILE_SIZE, smaller groups may suit GPUs with fewer registers per lane
+
+// Dynamic resolution: while the view moves, rays are traced at a lower resolution when the GPU frame time exceeds the target
+// (The graphics pass upscales the result, and the full resolution is restored once the view is still)
+static const bool      DYNAMIC_RESOLUTION = true;
+static const float     DYNAMIC_RESOLUTION_TARGET_MS = 16.f; // GPU time budget of a frame's compute work
+static const float     DYNAMIC_RESOLUTION_MIN_SCALE = 0.4f; // Lowest fraction of the full width and height
+
+// Interleaved tracing: while the view moves, only one of every INTERLEAVE pixels is traced per frame (1, 2 or 4, see INTERLEAVE_SLOT)
+// (The rest are reconstructed from their neighbours and the reprojected history, the I key cycles through the modes)
+static const uint32_t  INTERLEAVE = 2;
+
+// Sample budgets: pixels away from the fovea get fewer rays, scaled by the (optional) weight image below (white is the full budget)
+// (Pixels around the holes always get every ray, the B key toggles the budgets)
+static const char*     BUDGET_MAP_PATH = "../resources/textures/budget.png";
+
+// Format of the traced (HDR) output image, which the present pass exposes and tonemaps (see TONEMAP_*)
+// B10G11R11_UFLOAT packs it into 4 bytes per pixel like rgba8, R16G16B16A16_SFLOAT keeps more precision for twice the bandwidth
+// (Falls back on the other if the device can't store to it)
+static const VkFormat  OUTPUT_FORMAT = VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+static const uint32_t  TONEMAP = TONEMAP_ACES; // [ and ] adjust the exposure, M cycles the tonemapping curve
+
+// Async compute: trace on a dedicated compute queue family when the device has one, so the next frame's trace overlaps this frame's present
+// (The output image's ownership is handed between the families every frame, devices without one share the graphics queue)
+static const bool      ASYNC_COMPUTE = true;
+
+// Direct present: a compute kernel writes the output image straight into the swapchain images, when the surface allows storage images
+// (Otherwise, or when off, a fullscreen render pass samples the output image onto them)
+static const bool      DIRECT_PRESENT = true;
+
+// Demo objects: each adds a sample of a feature to the default scene (off, so the stock render stays the plain hole and disk)
+static const bool      DEMO_VOLUME = false; // An emissive disk-and-jets volume around the hole
+static const bool      DEMO_SDF = false; // A station built from signed distance functions, orbiting the hole
+static const bool      DEMO_MEDIUM = false; // A gradient-index medium with a textured, turbulent index field
 
 static const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
@@ -0,0 +1,132 @@
+#include "vulkanApplication.h"
+
+#include <set>
+
+
+/**
+ *  Hands every compute resource from the graphics family, which uploaded them, to the compute family.
+ *  Only the output images are handed back and forth after this, see recordOutputTransfer.
+ *  Does nothing when both queues are of the same family.
+ */
+void VulkanApplication::transferComputeOwnership() {
+    if (computeFamily == graphicsFamily) return;
+
+    // Gather the barriers, once per buffer and image
+    // (Those which aren't per frame are shared by every frame's descriptor set)
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    std::set<uint64_t> handles;
+
+    for (auto& [binding, memory] : computeBundle.bufferMemories) {
+        for (VkBuffer buffer : memory.buffers) {
+            if (!handles.insert((uint64_t)buffer).second) continue;
+
+            VkBufferMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = graphicsFamily;
+            barrier.dstQueueFamilyIndex = computeFamily;
+            barrier.buffer = buffer;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            bufferBarriers.push_back(barrier);
+        }
+    }
+
+    for (auto& [binding, memory] : computeBundle.imageMemories) {
+        for (size_t i = 0; i < memory.image.size(); i++) {
+            if (!handles.insert((uint64_t)memory.image[i]).second) continue;
+
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = memory.layout[i];
+            barrier.newLayout = memory.layout[i];
+            barrier.srcQueueFamilyIndex = graphicsFamily;
+            barrier.dstQueueFamilyIndex = computeFamily;
+            barrier.image = memory.image[i];
+            barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+            imageBarriers.push_back(barrier);
+        }
+    }
+
+    // Release on the graphics queue
+    // (Host writes to the mapped buffers need no release, submitting makes them visible)
+    for (auto& barrier : bufferBarriers) barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    for (auto& barrier : imageBarriers) barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+        0, nullptr,
+        (uint32_t)bufferBarriers.size(), bufferBarriers.data(),
+        (uint32_t)imageBarriers.size(), imageBarriers.data()
+    );
+    endSingleTimeCommands(commandBuffer, commandPool, device, graphicsQueue);
+
+    // Acquire on the compute queue, except for the output images, which every frame acquires itself
+    // (endSingleTimeCommands waits for the queue to idle, which orders the release before the acquire)
+    for (auto& barrier : bufferBarriers) {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    }
+    std::set<uint64_t> outputImages;
+    for (VkImage image : computeBundle.imageMemories[b_image].image) outputImages.insert((uint64_t)image);
+
+    std::vector<VkImageMemoryBarrier> acquireBarriers;
+    for (auto barrier : imageBarriers) {
+        if (outputImages.count((uint64_t)barrier.image)) continue;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        acquireBarriers.push_back(barrier);
+    }
+
+    commandBuffer = beginSingleTimeCommands(device, computeCommandPool);
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+        0, nullptr,
+        (uint32_t)bufferBarriers.size(), bufferBarriers.data(),
+        (uint32_t)acquireBarriers.size(), acquireBarriers.data()
+    );
+    endSingleTimeCommands(commandBuffer, computeCommandPool, device, computeQueue);
+}
+
+/**
+ *  Records one half of handing this frame's output image between the compute and graphics families.
+ *  The compute work acquires it at its start and releases it at its end, the graphics work the other way around,
+ *  and each release is ordered before its acquire by the timeline semaphores (see drawFrame).
+ *  Does nothing when both queues are of the same family.
+ *
+ *  @param commandBuffer The command buffer, of the family which releases or acquires the image.
+ *  @param toGraphics Whether the image goes from the compute family to the graphics family, rather than back.
+ *  @param release Whether to record the release, rather than the acquire.
+ */
+void VulkanApplication::recordOutputTransfer(VkCommandBuffer commandBuffer, bool toGraphics, bool release) {
+    if (computeFamily == graphicsFamily) return;
+
+    // (The stage and accesses of the family recording the barrier, the other family's half sets its own)
+    // (The graphics family reads the image in the present kernel, or in the fallback render pass's fragment shader)
+    bool onCompute = toGraphics == release;
+    VkPipelineStageFlags stage = onCompute || directPresent ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    VkAccessFlags access = onCompute ? VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = release ? access : 0;
+    barrier.dstAccessMask = release ? 0 : access;
+    barrier.oldLayout = computeBundle.imageMemories[b_image].layout[currentFrame];
+    barrier.newLayout = barrier.oldLayout;
+    barrier.srcQueueFamilyIndex = toGraphics ? computeFamily : graphicsFamily;
+    barrier.dstQueueFamilyIndex = toGraphics ? graphicsFamily : computeFamily;
+    barrier.image = computeBundle.imageMemories[b_image].image[currentFrame];
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        stage, // (Acquires chain onto the semaphore wait, which is at this stage, see drawFrame)
+        release ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : stage, 0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier
+    );
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include "glsl_cpp_common.h"
+
+#include <vector>
+#include <cstdio>
+
+
+/**
+ *  Loads a user-supplied sample budget map, which weighs how many rays every part of the screen gets.
+ *  The image's first channel is box-filtered down to RT_BUDGET_MAP_SIZE^2 weights, with white getting the full budget.
+ *  Without an image, every weight is 1 and only the fovea shapes the budget.
+ *
+ *  @param filePath Path to the image, top row first as on screen.
+ *
+ *  @return The weights in [0, 1], row by row.
+ */
+std::vector<float> inline loadBudgetMap(const char* filePath) {
+    const int size = RT_BUDGET_MAP_SIZE;
+    std::vector<float> weights(size * size, 1.f);
+
+    int width, height, channels;
+    stbi_uc* pixels = stbi_load(filePath, &width, &height, &channels, STBI_grey);
+    if (!pixels) {
+        printf("No sample budget map at %s, budgets follow the fovea only\n", filePath);
+        return weights;
+    }
+
+    for (int y = 0; y < size; y++)
+    for (int x = 0; x < size; x++) {
+        // Average the texels covered by the cell (at least the nearest one)
+        int x0 = x * width / size, x1 = glm::max((x + 1) * width / size, x0 + 1),
+            y0 = y * height / size, y1 = glm::max((y + 1) * height / size, y0 + 1);
+        float sum = 0.f;
+        for (int ty = y0; ty < y1; ty++)
+        for (int tx = x0; tx < x1; tx++)
+            sum += pixels[tx + ty * width];
+        weights[x + y * size] = sum / (255.f * (x1 - x0) * (y1 - y0));
+    }
+
+    stbi_image_free(pixels);
+    return weights;
+}
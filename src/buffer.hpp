@@ -73,6 +73,9 @@ struct BufferBundle {
     std::map<uint32_t, BufferMemory> bufferMemories;
     std::map<uint32_t, ImageMemory>  imageMemories;
 
+    // Incremented by every updateBuffer call, so that anything derived from the contents (i.e. accumulated frames) can tell when they change
+    uint32_t version = 0;
+
     /**
      *  Updates the contents of a Uniform Buffer Object.
      *  
@@ -95,10 +98,11 @@ struct BufferBundle {
         // If no frames are selected for updating, return
         if (frames.size() == 0)
             return;
+        version++;
 
         // If the only frame selected for updating is "-1", update all frames
         if (frames.size() == 1 && frames[0] == -1) {
-            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+            for (size_t i = 0; i < framesInFlight; i++)
                 memcpy(bufferMemories[binding].buffersMapped[i], data.data(), sizeof(T) * data.size());
             return;
         }
@@ -106,7 +110,7 @@ struct BufferBundle {
         // Otherwise, update specified frames
         for (auto i : frames) {
             // (if frame-to-update is outside of bounds, throw an error)
-            if (i >= MAX_FRAMES_IN_FLIGHT)
+            if (i >= (int)framesInFlight)
                 throw std::runtime_error("ERR::VULKAN::UPDATE_BUFFER::INVALID_FRAME");
             memcpy(bufferMemories[binding].buffersMapped[i], data.data(), sizeof(T) * data.size());
         }
@@ -225,18 +229,18 @@ public:
         bufferMemories[binding] = bufferMemory;
 
         deletionQueue->addDeletor([=]() {
-            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            for (size_t i = 0; i < framesInFlight; i++) {
                 vkDestroyBuffer(device, bufferMemory.buffers[i], nullptr);
                 vkFreeMemory(device, bufferMemory.buffersMemory[i], nullptr);
             }
         });
 
         // Create and push descriptor writes
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < framesInFlight; i++) {
             VkDescriptorBufferInfo *bufferInfo = new VkDescriptorBufferInfo {};
             bufferInfo->buffer = bufferMemory.buffers[i];
             bufferInfo->offset = 0;
-            bufferInfo->range = sizeof(T) * initialData.size();
+            bufferInfo->range = initialData.size() > 0 ? sizeof(T) * initialData.size() : VK_WHOLE_SIZE; // (Empty buffers still hold a single element)
 
             VkWriteDescriptorSet write {};
             write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -327,6 +331,8 @@ public:
      *  @param existingImage Image memory to create the layout for. If left empty, an image is created.
      *  @param width If creating an image, the width of that image.
      *  @param height If creating an image, the height of that image.
+     *  @param format If creating an image, the format of that image.
+     *  @param perFrame If creating an image, whether each frame in flight gets its own copy. Shared images must be synchronized by the user.
      * 
      *  @return itself, for functional purposes.
      */
@@ -339,7 +345,9 @@ public:
         char*               filePath = nullptr,
         ImageMemory*        existingImage = nullptr,
         uint32_t            width = NULL,
-        uint32_t            height = NULL
+        uint32_t            height = NULL,
+        VkFormat            format = VK_FORMAT_R8G8B8A8_UNORM,
+        bool                perFrame = true
     ) {
         // Early error handling
         if (!sampled && !storage)
@@ -397,11 +405,11 @@ public:
             imageMemories[binding] = ImageMemory{};
             existingImage = &imageMemories[binding];
 
-            existingImage->image.resize(MAX_FRAMES_IN_FLIGHT);
-            existingImage->imageView.resize(MAX_FRAMES_IN_FLIGHT);
-            existingImage->imageMemory.resize(MAX_FRAMES_IN_FLIGHT);
-            existingImage->sampler.resize(MAX_FRAMES_IN_FLIGHT);
-            existingImage->layout.resize(MAX_FRAMES_IN_FLIGHT);
+            existingImage->image.resize(framesInFlight);
+            existingImage->imageView.resize(framesInFlight);
+            existingImage->imageMemory.resize(framesInFlight);
+            existingImage->sampler.resize(framesInFlight);
+            existingImage->layout.resize(framesInFlight);
 
             //properties
             //existingImage->layout = storage ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -409,11 +417,12 @@ public:
             if (filePath != nullptr) usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
             //image
-            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            size_t imageCount = perFrame ? framesInFlight : 1;
+            for (size_t i = 0; i < imageCount; i++) {
                 existingImage->layout[i] = filePath != nullptr ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : (storage ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
                 createImage (
                     width, height, 1,
-                    VK_FORMAT_R8G8B8A8_UNORM,
+                    format,
                     VK_IMAGE_TILING_OPTIMAL,
                     usage,
                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
@@ -426,7 +435,7 @@ public:
                 //layout
                 transitionImageLayout (
                     existingImage->image[i],
-                    VK_FORMAT_R8G8B8A8_UNORM,
+                    format,
                     VK_IMAGE_LAYOUT_UNDEFINED,
                     existingImage->layout[i],
                     1,
@@ -441,7 +450,7 @@ public:
                     auto newLayout = storage ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
                     transitionImageLayout(
                         existingImage->image[i],
-                        VK_FORMAT_R8G8B8A8_UNORM,
+                        format,
                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                         newLayout,
                         1,
@@ -455,7 +464,7 @@ public:
                 //view
                 existingImage->imageView[i] = createImageView(
                     existingImage->image[i],
-                    VK_FORMAT_R8G8B8A8_UNORM,
+                    format,
                     VK_IMAGE_ASPECT_COLOR_BIT,
                     1, 
                     device
@@ -478,6 +487,15 @@ public:
                     vkDestroySampler(device, sampler, nullptr);
                 });
             }
+
+            //shared images are referenced by every frame
+            for (size_t i = imageCount; i < framesInFlight; i++) {
+                existingImage->image[i] = existingImage->image[0];
+                existingImage->imageView[i] = existingImage->imageView[0];
+                existingImage->imageMemory[i] = existingImage->imageMemory[0];
+                existingImage->sampler[i] = existingImage->sampler[0];
+                existingImage->layout[i] = existingImage->layout[0];
+            }
         }
         // If the image already exists, verify and bind it
         else {
@@ -487,7 +505,7 @@ public:
         }
 
         // Create and push descriptor writes
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < framesInFlight; i++) {
             VkDescriptorImageInfo* imageInfo = new VkDescriptorImageInfo{};
             imageInfo->imageLayout = existingImage->layout[i];
             imageInfo->imageView = existingImage->imageView[i];
@@ -513,6 +531,143 @@ public:
         return *this;
     }
 
+    /**
+     *  Creates and adds a sampled 3D image (volume) to the layout.
+     *  The volume is uploaded once, shared by every frame, and sampled with clamped, linearly filtered lookups.
+     *  
+     *  @param binding Binding, as in shader-code.
+     *  @param stageFlags Which stages the volume should be visible to.
+     *  @param format The texel format, which must match the layout of data.
+     *  @param width The width of the volume.
+     *  @param height The height of the volume.
+     *  @param depth The depth of the volume.
+     *  @param data The texels, ordered x, then y, then z.
+     *  @param addressModeU How the x axis is addressed, VK_SAMPLER_ADDRESS_MODE_REPEAT for periodic coordinates (the others are clamped).
+     * 
+     *  @return itself, for functional purposes.
+     */
+    template<typename T>
+    BufferBuilder volume (
+        uint32_t            binding,
+        VkShaderStageFlags  stageFlags,
+        VkFormat            format,
+        uint32_t            width,
+        uint32_t            height,
+        uint32_t            depth,
+        const std::vector<T>& data,
+        VkSamplerAddressMode addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE
+    ) {
+        // Early error handling
+        VkDeviceSize imageSize = sizeof(T) * data.size();
+        if (width == 0 || height == 0 || depth == 0 || imageSize == 0)
+            throw std::runtime_error("ERR::VULKAN::VOLUME::INVALID_DIMENSIONS");
+
+        // Create and push layout bindings
+        layoutBindings.push_back(
+            VkDescriptorSetLayoutBinding{ binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, stageFlags, nullptr }
+        );
+
+        // Add pool sizes
+        addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+
+        // Create staging buffer and transfer data
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        createBuffer(
+            imageSize,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            physicalDevice,
+            device,
+            stagingBuffer,
+            stagingBufferMemory
+        );
+
+        void* ptr;
+        vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &ptr);
+        memcpy(ptr, data.data(), static_cast<size_t>(imageSize));
+        vkUnmapMemory(device, stagingBufferMemory);
+
+        // Create images
+        imageMemories[binding] = ImageMemory{};
+        ImageMemory* volumeImage = &imageMemories[binding];
+
+        volumeImage->image.resize(framesInFlight);
+        volumeImage->imageView.resize(framesInFlight);
+        volumeImage->imageMemory.resize(framesInFlight);
+        volumeImage->sampler.resize(framesInFlight);
+        volumeImage->layout.resize(framesInFlight, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        //image (uploaded once, as the volume never changes)
+        createImage (
+            width, height, 1,
+            format,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            physicalDevice,
+            device,
+            volumeImage->image[0],
+            volumeImage->imageMemory[0],
+            depth,
+            VK_IMAGE_TYPE_3D
+        );
+
+        //layout and data
+        transitionImageLayout(volumeImage->image[0], format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, device, commandPool, queue);
+        copyBufferToImage(stagingBuffer, volumeImage->image[0], width, height, device, commandPool, queue, depth);
+        transitionImageLayout(volumeImage->image[0], format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1, device, commandPool, queue);
+
+        //view and sampler
+        volumeImage->imageView[0] = createImageView(volumeImage->image[0], format, VK_IMAGE_ASPECT_COLOR_BIT, 1, device, VK_IMAGE_VIEW_TYPE_3D);
+        createSampler(physicalDevice, device, volumeImage->sampler[0], VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, addressModeU);
+
+        //cleanup
+        VkImageView imageView = volumeImage->imageView[0];
+        VkImage image = volumeImage->image[0];
+        VkDeviceMemory imageMemory = volumeImage->imageMemory[0];
+        VkSampler sampler = volumeImage->sampler[0];
+
+        deletionQueue->addDeletor([=]() {
+            vkDestroyImageView(device, imageView, nullptr);
+            vkDestroyImage(device, image, nullptr);
+            vkFreeMemory(device, imageMemory, nullptr);
+            vkDestroySampler(device, sampler, nullptr);
+        });
+
+        //the volume is referenced by every frame
+        for (size_t i = 1; i < framesInFlight; i++) {
+            volumeImage->image[i] = volumeImage->image[0];
+            volumeImage->imageView[i] = volumeImage->imageView[0];
+            volumeImage->imageMemory[i] = volumeImage->imageMemory[0];
+            volumeImage->sampler[i] = volumeImage->sampler[0];
+        }
+
+        //descriptor writes
+        for (size_t i = 0; i < framesInFlight; i++) {
+            VkDescriptorImageInfo* imageInfo = new VkDescriptorImageInfo{};
+            imageInfo->imageLayout = volumeImage->layout[i];
+            imageInfo->imageView = volumeImage->imageView[i];
+            imageInfo->sampler = volumeImage->sampler[i];
+
+            VkWriteDescriptorSet write {};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstBinding = binding;
+            write.dstArrayElement = 0;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            write.pImageInfo = imageInfo;
+
+            descriptorWrites[i].push_back(write);
+        }
+
+        // Cleanup staging buffer
+        vkDestroyBuffer(device, stagingBuffer, nullptr);
+        vkFreeMemory(device, stagingBufferMemory, nullptr);
+
+        return *this;
+    }
+
     /**
      *  Builds the Buffer Bundle.
      */
@@ -543,7 +698,7 @@ private:
     // Descriptors
     std::vector<VkDescriptorSetLayoutBinding> layoutBindings {};
     std::vector<VkDescriptorPoolSize> poolSizes {};
-    std::array<std::vector<VkWriteDescriptorSet>, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT)> descriptorWrites {};
+    std::vector<std::vector<VkWriteDescriptorSet>> descriptorWrites = std::vector<std::vector<VkWriteDescriptorSet>>(framesInFlight);
 
     // Memory
     std::map<uint32_t, BufferMemory> bufferMemories;
@@ -561,11 +716,11 @@ private:
     void addPoolSize( VkDescriptorType type ) {
         for (size_t i = 0; i < poolSizes.size(); i++)
             if (poolSizes[i].type == type) {
-                poolSizes[i].descriptorCount += static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+                poolSizes[i].descriptorCount += framesInFlight;
                 return;
             }
         poolSizes.push_back(
-            VkDescriptorPoolSize{ type, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) }
+            VkDescriptorPoolSize{ type, framesInFlight }
         );
     }
 
@@ -596,7 +751,7 @@ private:
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
         poolInfo.pPoolSizes = poolSizes.data();
-        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        poolInfo.maxSets = framesInFlight;
 
         if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
             throw std::runtime_error("ERR::VULKAN::CREATE_DESCRIPTOR_POOL::CREATION_FAILED");
@@ -615,23 +770,23 @@ private:
      */
     void createDescriptorSets() {
         // Prepare as many descriptor sets as there are frames-in-flight
-        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
+        std::vector<VkDescriptorSetLayout> layouts(framesInFlight, descriptorSetLayout);
         VkDescriptorSetAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
         allocInfo.descriptorPool = descriptorPool;
-        allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        allocInfo.descriptorSetCount = framesInFlight;
         allocInfo.pSetLayouts = layouts.data();
 
         // Allocate the descriptors
         // (these are automatically destroyed when pool is deleted)
         // (Also, if createDescriptorPool is wrong, this might not give any warnings)
-        descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+        descriptorSets.resize(framesInFlight);
         auto err = vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data());
         if (err != VK_SUCCESS)
             throw std::runtime_error("ERR::VULKAN::CREATE_DESCRIPTOR_SETS::DESCRIPTOR_SETS_ALLOCATION_FAILED");
     
         // Update descriptor sets
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < framesInFlight; i++) {
             for (size_t j = 0; j < descriptorWrites[i].size(); j++)
                 descriptorWrites[i][j].dstSet = descriptorSets[i];
             vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites[i].size()), descriptorWrites[i].data(), 0, nullptr);
@@ -5,27 +5,38 @@ void VulkanApplication::cleanup() {
     //swapchain
     cleanupSwapChain();
 
+    //pipeline cache
+    savePipelineCache();
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
+
+    //timestamps
+    if (timestampPool != VK_NULL_HANDLE) vkDestroyQueryPool(device, timestampPool, nullptr);
+
     //pipeline
     vkDestroyPipeline(device, graphicsPipeline, nullptr);
     vkDestroyPipelineLayout(device, graphicsPipelineLayout, nullptr);
 
-    vkDestroyPipeline(device, computePipeline, nullptr);
+    vkDestroyPipeline(device, presentPipeline, nullptr);
+    vkDestroyPipelineLayout(device, presentPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, presentSetLayout, nullptr);
+
+    destroyComputeKernels();
     vkDestroyPipelineLayout(device, computePipelineLayout, nullptr);
 
     //renderpass
     vkDestroyRenderPass(device, renderPass, nullptr);
 
     //synchronization objects
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (size_t i = 0; i < framesInFlight; i++) {
         vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
         vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-        vkDestroyFence(device, inFlightFences[i], nullptr);
-        vkDestroyFence(device, computeInFlightFences[i], nullptr);
-        vkDestroySemaphore(device, computeFinishedSemaphores[i], nullptr);
     }
+    vkDestroySemaphore(device, computeTimeline, nullptr);
+    vkDestroySemaphore(device, graphicsTimeline, nullptr);
 
     //commandpool
     vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroyCommandPool(device, computeCommandPool, nullptr);
 
     //logical device
     vkDestroyDevice(device, nullptr);
@@ -1,26 +1,59 @@
 #include "vulkanApplication.h"
 
 #include <iostream>
+#include <cstring>
 
 
 /**
- *  Creates the compute pipeline.
+ *  Gets the trace kernel variant for a set of scene features, creating and caching it on first use.
+ *
+ *  @param features The scene features, see SceneFeatures.
+ *
+ *  @return The pipeline.
  */
-void VulkanApplication::createComputePipeline() {
+VkPipeline VulkanApplication::getTraceVariant(uint32_t features) {
+	auto cached = traceVariants.find(features);
+	if (cached != traceVariants.end()) return cached->second;
+
 	// Load compute shader
-	auto compShaderCode = readFile("../resources/shaders/comp.spv");
+	// (Every metric has its own variant, so the per-step code has no runtime switch)
+	auto compShaderCode = loadShader(ActiveMetric::shaderName);
 
 	// Create shader module
 	VkShaderModule  compShaderModule = createShaderModule(compShaderCode);
 
 	// Assign pipeline stages
+	// (The specialization constants fold the tuning constants and compile out the loops over absent features)
+	TraceSpecialization specialization(features);
+
 	VkPipelineShaderStageCreateInfo compShaderStageInfo{};
 	compShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
 	compShaderStageInfo.module = compShaderModule;
 	compShaderStageInfo.pName = "main"; //entrypoint
-	compShaderStageInfo.pSpecializationInfo = nullptr; //can be used to set const values in shader before compilation!
+	compShaderStageInfo.pSpecializationInfo = &specialization.info;
 
+	// Pipeline
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.layout = computePipelineLayout;
+    pipelineInfo.stage = compShaderStageInfo;
+
+    //create compute pipeline
+	VkPipeline pipeline;
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+		throw std::runtime_error("ERR::VULKAN::GET_TRACE_VARIANT::PIPELINE_CREATION_FAILED");
+
+	vkDestroyShaderModule(device, compShaderModule, nullptr);
+
+	traceVariants[features] = pipeline;
+	return pipeline;
+}
+
+/**
+ *  Creates the compute pipeline.
+ */
+void VulkanApplication::createComputePipeline() {
 	// Pipeline layout
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -29,7 +62,7 @@ void VulkanApplication::createComputePipeline() {
 
     VkPushConstantRange computePushConstants = VkPushConstantRange{};
     computePushConstants.offset = 0;
-    computePushConstants.size = computePushConstantSize;
+    computePushConstants.size = sizeof(RTDispatch);
     computePushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
     pipelineLayoutInfo.pPushConstantRanges = &computePushConstants;
@@ -38,21 +71,122 @@ void VulkanApplication::createComputePipeline() {
 	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &computePipelineLayout) != VK_SUCCESS)
 		throw std::runtime_error("ERR::VULKAN::CREATE_COMPUTE_PIPELINE::PIPELINE_LAYOUT_CREATION_FAILED");
 
-	// Pipeline
-    VkComputePipelineCreateInfo pipelineInfo{};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-    pipelineInfo.layout = computePipelineLayout;
-    pipelineInfo.stage = compShaderStageInfo;
+	createComputeKernels();
+}
 
-    //create compute pipeline
-	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS)
-		throw std::runtime_error("ERR::VULKAN::CREATE_COMPUTE_PIPELINE::PIPELINE_CREATION_FAILED");
+/**
+ *  Creates the pipelines of every compute kernel, using the existing compute pipeline layout.
+ *  (Split from createComputePipeline so the kernels can be swapped when the shaders are hot reloaded)
+ */
+void VulkanApplication::createComputeKernels() {
+	// (Command buffers recorded with the previous kernels are recorded again)
+	commandsVersion++;
 
-	vkDestroyShaderModule(device, compShaderModule, nullptr);
+	// Trace kernel, for the scene's features
+	computePipeline = getTraceVariant(traceFeatures);
+
+	// The other kernels share the layout, as they read the same descriptors and push constants
+	// (Those including raytracing.glsl are specialized like the trace kernel)
+	TraceSpecialization specialization(traceFeatures);
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.layout = computePipelineLayout;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.stage.pSpecializationInfo = &specialization.info;
+
+	// Tile classification pipeline
+	auto classifyShaderCode = loadShader("classify.spv");
+	VkShaderModule classifyShaderModule = createShaderModule(classifyShaderCode);
+	pipelineInfo.stage.module = classifyShaderModule;
+
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &classifyPipeline) != VK_SUCCESS)
+		throw std::runtime_error("ERR::VULKAN::CREATE_COMPUTE_PIPELINE::CLASSIFY_PIPELINE_CREATION_FAILED");
+
+	vkDestroyShaderModule(device, classifyShaderModule, nullptr);
+
+	// Temporal reprojection pipeline
+	auto temporalShaderCode = loadShader("temporal.spv");
+	VkShaderModule temporalShaderModule = createShaderModule(temporalShaderCode);
+	pipelineInfo.stage.module = temporalShaderModule;
+
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &temporalPipeline) != VK_SUCCESS)
+		throw std::runtime_error("ERR::VULKAN::CREATE_COMPUTE_PIPELINE::TEMPORAL_PIPELINE_CREATION_FAILED");
+
+	vkDestroyShaderModule(device, temporalShaderModule, nullptr);
+
+	// Denoiser pipeline
+	auto atrousShaderCode = loadShader("atrous.spv");
+	VkShaderModule atrousShaderModule = createShaderModule(atrousShaderCode);
+	pipelineInfo.stage.module = atrousShaderModule;
+
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &atrousPipeline) != VK_SUCCESS)
+		throw std::runtime_error("ERR::VULKAN::CREATE_COMPUTE_PIPELINE::ATROUS_PIPELINE_CREATION_FAILED");
+
+	vkDestroyShaderModule(device, atrousShaderModule, nullptr);
+
+	// Wavefront stages
+	if (TRACE_MODE == TraceMode::Wavefront) createWavefrontPipelines(pipelineInfo);
+
+	// Persistent threads
+	if (TRACE_MODE == TraceMode::Persistent) {
+		auto persistentShaderCode = loadShader("persistent.spv");
+		VkShaderModule persistentShaderModule = createShaderModule(persistentShaderCode);
+		pipelineInfo.stage.module = persistentShaderModule;
+
+		if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &persistentPipeline) != VK_SUCCESS)
+			throw std::runtime_error("ERR::VULKAN::CREATE_COMPUTE_PIPELINE::PERSISTENT_PIPELINE_CREATION_FAILED");
+
+		vkDestroyShaderModule(device, persistentShaderModule, nullptr);
+		persistentWorkgroups = countPersistentWorkgroups();
+	}
+}
+
+/**
+ *  Destroys the pipelines of every compute kernel, but not the layout they share.
+ */
+void VulkanApplication::destroyComputeKernels() {
+	for (auto& variant : traceVariants) vkDestroyPipeline(device, variant.second, nullptr);
+	traceVariants.clear();
+	computePipeline = VK_NULL_HANDLE;
+
+	vkDestroyPipeline(device, classifyPipeline, nullptr);
+	classifyPipeline = VK_NULL_HANDLE;
+
+	vkDestroyPipeline(device, temporalPipeline, nullptr);
+	temporalPipeline = VK_NULL_HANDLE;
+
+	vkDestroyPipeline(device, atrousPipeline, nullptr);
+	atrousPipeline = VK_NULL_HANDLE;
+
+	for (VkPipeline& pipeline : wavefrontPipelines) {
+		vkDestroyPipeline(device, pipeline, nullptr);
+		pipeline = VK_NULL_HANDLE;
+	}
+
+	vkDestroyPipeline(device, persistentPipeline, nullptr);
+	persistentPipeline = VK_NULL_HANDLE;
+}
+
+/**
+ *  Gets what the compute command buffer would be recorded for this frame, see ComputeCommandsKey.
+ */
+ComputeCommandsKey VulkanApplication::computeCommandsKey() {
+    return ComputeCommandsKey{
+        commandsVersion,
+        traceExtent.width, traceExtent.height,
+        denoiseIterations,
+        TRACE_MODE == TraceMode::Wavefront ? frame.raysPerFrag : 0,
+        TRACE_MODE == TraceMode::Wavefront ? wavefrontRounds : 0
+    };
 }
 
 /**
  *  Records the command buffer for Compute.
+ *  Only records what doesn't change from frame to frame, the rest is read from mapped memory (see writeFrameState),
+ *  so the command buffer is submitted again as is until computeCommandsKey changes.
  */
 void VulkanApplication::recordComputeCommandBuffer(VkCommandBuffer commandBuffer) {
     // Supply details about the usage of this specific command buffer
@@ -66,18 +200,98 @@ void VulkanApplication::recordComputeCommandBuffer(VkCommandBuffer commandBuffer
 
     if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
         throw std::runtime_error("ERR::VULKAN::RECORD_COMPUTE_COMMAND_BUFFER::COMMAND_BUFFER_BEGIN_FAILED");
+    recordFrameTimestamp(commandBuffer, false);
+
+    // Take this frame's output image back from the graphics family
+    recordOutputTransfer(commandBuffer, false, false);
+
+    // Wait for the previous frame's writes to the (shared) accumulation image
+    VkMemoryBarrier accumulationBarrier{};
+    accumulationBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    accumulationBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    accumulationBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        1, &accumulationBarrier,
+        0, nullptr,
+        0, nullptr
+    );
 
-    // Bind pipeline
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+    // Bind descriptors
     vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1, &computeBundle.descriptorSets[currentFrame], 0, nullptr);
 
-    // TODO: MAKE THIS MODULAR INSTEAD OF FORCED STATIC CAST
-    vkCmdPushConstants(commandBuffer, computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, computePushConstantSize, (RTFrame*)computePushConstantReference);
+    // Reset the tile list, whose header is the trace kernel's indirect dispatch arguments
+    VkBuffer tileBuffer = computeBundle.bufferMemories[b_tiles].buffers[currentFrame];
+    uint32_t emptyDispatch[3] = { 0, 1, 1 };
+    vkCmdUpdateBuffer(commandBuffer, tileBuffer, 0, sizeof(emptyDispatch), emptyDispatch);
+    if (TRACE_MODE == TraceMode::Persistent) {
+        uint32_t emptyCounter = 0;
+        vkCmdUpdateBuffer(commandBuffer, computeBundle.bufferMemories[b_workCounter].buffers[currentFrame], 0, sizeof(emptyCounter), &emptyCounter);
+    }
+
+    VkMemoryBarrier resetBarrier{};
+    resetBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &resetBarrier, 0, nullptr, 0, nullptr);
+
+    // Classify tiles, compacting those which still need samples into the tile list
+    // (Only those of the part of the images traced this frame, see updateTraceExtent)
+    uint32_t    tilesX = (traceExtent.width + RT_TILE_SIZE - 1) / RT_TILE_SIZE,
+                tilesY = (traceExtent.height + RT_TILE_SIZE - 1) / RT_TILE_SIZE;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, classifyPipeline);
+    vkCmdDispatch(commandBuffer, tilesX, tilesY, 1);
+
+    VkMemoryBarrier classifyBarrier{};
+    classifyBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    classifyBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    classifyBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        1, &classifyBarrier,
+        0, nullptr,
+        0, nullptr
+    );
+
+    // Trace the listed tiles, one workgroup each
+    // (Or, with persistent threads, just enough workgroups to fill the device, which take pixels of the listed tiles as they go)
+    if (TRACE_MODE == TraceMode::Wavefront) {
+        recordWavefrontCommands(commandBuffer, tileBuffer);
+    } else if (TRACE_MODE == TraceMode::Persistent) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, persistentPipeline);
+        vkCmdDispatch(commandBuffer, persistentWorkgroups, 1, 1);
+    } else {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+        vkCmdDispatchIndirect(commandBuffer, tileBuffer, 0);
+    }
+
+    VkMemoryBarrier traceBarrier{};
+    traceBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    traceBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    traceBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &traceBarrier, 0, nullptr, 0, nullptr);
+
+    // Blend with the (reprojected) history, and output
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, temporalPipeline);
+    vkCmdDispatch(commandBuffer, (traceExtent.width + 15) / 16, (traceExtent.height + 15) / 16, 1);
+
+    // Denoise, each iteration reading the previous one's output
+    if (denoiseIterations > 0) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, atrousPipeline);
+        for (uint32_t iteration = 0; iteration < denoiseIterations; iteration++) {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &traceBarrier, 0, nullptr, 0, nullptr);
+            RTDispatch dispatch{ 0, iteration, 0 };
+            vkCmdPushConstants(commandBuffer, computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(RTDispatch), &dispatch);
+            vkCmdDispatch(commandBuffer, (traceExtent.width + 15) / 16, (traceExtent.height + 15) / 16, 1);
+        }
+    }
+
+    // Hand the output image to the graphics family
+    recordOutputTransfer(commandBuffer, true, true);
 
-    // Dispatch and commit
-    //vkCmdDispatch(commandBuffer, static_cast<uint32_t>(swapChainExtent.width), static_cast<uint32_t>(swapChainExtent.height), 1); // TODO: ADD PARTICLE_COUNT VARIABLE
-    //vkCmdDispatch(commandBuffer, WIDTH / 32, HEIGHT / 32, 1); // TODO: ADD PARTICLE_COUNT VARIABLE
-    vkCmdDispatchIndirect(commandBuffer, dispatchBuffer, 0); // TODO: REMOVE THIS AND DISPATCH BUFFER
+    recordFrameTimestamp(commandBuffer, true);
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
         throw std::runtime_error("ERR::VULKAN::RECORD_COMPUTE_COMMAND_BUFFER::COMMIT_FAILED");
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <set>
+#include <algorithm>
 
 /**
  *	Picks a physical device.
@@ -51,6 +52,7 @@ bool VulkanApplication::isDeviceSuitable(VkPhysicalDevice device) {
     VkPhysicalDeviceFeatures supportedFeatures;
     vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
     bool isValid = indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+    isValid &= supportedFeatures.shaderStorageImageWriteWithoutFormat; // (The output image's format is picked at runtime)
 
     VkPhysicalDeviceAccelerationStructureFeaturesKHR accelFeatures{};
     accelFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
@@ -95,15 +97,18 @@ QueueFamilyIndices VulkanApplication::findQueueFamilies(VkPhysicalDevice device)
         //check if the current family supports rendering to khr surface
         VkBool32 presentSupport = false;
         vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-        if (presentSupport)
+        if (presentSupport && !indices.presentFamily.has_value())
             indices.presentFamily = i;
 
         //check if family supports VK_QUEUE_GRAPHICS_BIT and COMPUTE_BIT
-        if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT))
+        if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !indices.graphicsAndComputeFamily.has_value())
             indices.graphicsAndComputeFamily = i;
 
-        // (Early exit)
-        if (indices.isComplete()) break;
+        //check if family supports COMPUTE_BIT but not GRAPHICS_BIT, which GPUs tend to run alongside the graphics queue
+        if (!(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !indices.asyncComputeFamily.has_value())
+            indices.asyncComputeFamily = i;
+
+        // (No early exit, as the async compute family tends to come last)
         i++;
     }
 
@@ -130,15 +135,74 @@ bool VulkanApplication::checkDeviceExtensionSupport(VkPhysicalDevice device) {
     return requiredExtensions.empty();
 }
 
+/**
+ *  Picks the format of the (HDR) output image: OUTPUT_FORMAT if the device can store to, sample and filter it,
+ *  otherwise the first of the packed HDR formats which it can.
+ *
+ *  @return The format.
+ */
+VkFormat VulkanApplication::chooseOutputFormat() {
+    const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    const VkFormat candidates[] = { OUTPUT_FORMAT, VK_FORMAT_B10G11R11_UFLOAT_PACK32, VK_FORMAT_R16G16B16A16_SFLOAT };
+
+    for (VkFormat format : candidates) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+        if ((properties.optimalTilingFeatures & required) == required) {
+            if (format != OUTPUT_FORMAT) printf("Output format %i is not supported, using %i instead\n", OUTPUT_FORMAT, format);
+            return format;
+        }
+    }
+    throw std::runtime_error("ERR::VULKAN::CHOOSE_OUTPUT_FORMAT::NO_SUPPORTED_FORMAT");
+}
+
+/**
+ *  Counts the workgroups needed to fill the physical device with persistent threads.
+ *  The multiprocessor count is only reported through vendor extensions, otherwise PERSISTENT_FALLBACK_CORES is assumed.
+ *
+ *  @return The amount of workgroups.
+ */
+uint32_t VulkanApplication::countPersistentWorkgroups() {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+    std::set<std::string> extensions;
+    for (const auto& extension : availableExtensions) extensions.insert(extension.extensionName);
+
+    VkPhysicalDeviceShaderSMBuiltinsPropertiesNV smProperties{};
+    smProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_SM_BUILTINS_PROPERTIES_NV;
+    VkPhysicalDeviceShaderCorePropertiesAMD coreProperties{};
+    coreProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_CORE_PROPERTIES_AMD;
+
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    if (extensions.count(VK_NV_SHADER_SM_BUILTINS_EXTENSION_NAME)) properties.pNext = &smProperties;
+    else if (extensions.count(VK_AMD_SHADER_CORE_PROPERTIES_EXTENSION_NAME)) properties.pNext = &coreProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    uint32_t cores = PERSISTENT_FALLBACK_CORES;
+    if (properties.pNext == &smProperties) cores = smProperties.shaderSMCount;
+    else if (properties.pNext == &coreProperties)
+        cores = coreProperties.shaderEngineCount * coreProperties.shaderArraysPerEngineCount * coreProperties.computeUnitsPerShaderArray;
+
+    return std::max(cores, 1u) * PERSISTENT_WORKGROUPS_PER_CORE;
+}
+
 /**
  *  Creates a logical device using the set physicalDevice.
  */
 void VulkanApplication::createLogicalDevice() {
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+    graphicsFamily = indices.graphicsAndComputeFamily.value();
+    computeFamily = ASYNC_COMPUTE && indices.asyncComputeFamily.has_value() ? indices.asyncComputeFamily.value() : graphicsFamily;
+    printf("Tracing on queue family %u%s\n", computeFamily, computeFamily != graphicsFamily ? " (async compute)" : "");
 
     // Create queue info struct
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsAndComputeFamily.value(), indices.presentFamily.value() };
+    std::set<uint32_t> uniqueQueueFamilies = { graphicsFamily, computeFamily, indices.presentFamily.value() };
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -158,15 +222,22 @@ void VulkanApplication::createLogicalDevice() {
     accelFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
     accelFeatures.accelerationStructure = VK_TRUE;
 
+    // (Core since Vulkan 1.2, synchronizes the compute and graphics queues, see drawFrame)
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineFeatures.timelineSemaphore = VK_TRUE;
+    timelineFeatures.pNext = &accelFeatures;
+
     VkPhysicalDeviceBufferDeviceAddressFeatures deviceFeatures{};
     deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR;
     deviceFeatures.bufferDeviceAddress = VK_TRUE;
-    deviceFeatures.pNext = &accelFeatures;
+    deviceFeatures.pNext = &timelineFeatures;
 
     VkPhysicalDeviceFeatures2 deviceFeatures2{};
     deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
     deviceFeatures2.pNext = &deviceFeatures;
     deviceFeatures2.features.samplerAnisotropy = VK_TRUE;
+    deviceFeatures2.features.shaderStorageImageWriteWithoutFormat = VK_TRUE;
 
     // Create device info struct
     // TODO: ADD VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR AND MORE TO PNEXT
@@ -197,7 +268,7 @@ void VulkanApplication::createLogicalDevice() {
 
     // Create handle to device queue
     // (These will most likely have the same values, unless one device is not able to i.e. render)
-    vkGetDeviceQueue(device, indices.graphicsAndComputeFamily.value(), 0, &graphicsQueue);
-    vkGetDeviceQueue(device, indices.graphicsAndComputeFamily.value(), 0, &computeQueue);
+    vkGetDeviceQueue(device, graphicsFamily, 0, &graphicsQueue);
+    vkGetDeviceQueue(device, computeFamily, 0, &computeQueue);
     vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
 }
\ No newline at end of file
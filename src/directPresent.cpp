@@ -0,0 +1,163 @@
+#include "vulkanApplication.h"
+
+
+/**
+ *  Picks a swapchain format which the present kernel can store to, if the surface allows storage images at all.
+ *  Storage images can't be SRGB, so only UNORM formats are considered, and present.comp encodes the color itself.
+ *
+ *  @param support The surface's swapchain support.
+ *  @param surfaceFormat Set to the picked format, left alone if there is none.
+ *
+ *  @return Whether a format was picked, otherwise the fallback render pass presents.
+ */
+bool VulkanApplication::chooseDirectPresentFormat(const SwapChainSupportDetails& support, VkSurfaceFormatKHR& surfaceFormat) {
+    if (!(support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT)) return false;
+
+    const VkFormat candidates[] = { VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_A2B10G10R10_UNORM_PACK32 };
+    for (VkFormat candidate : candidates) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, candidate, &properties);
+        if (!(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)) continue;
+
+        for (const auto& availableFormat : support.formats) {
+            if (availableFormat.format == candidate && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+                surfaceFormat = availableFormat;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ *  Creates the present kernel, which writes the output image straight into the swapchain image.
+ *  Its first set is the graphics bundle's, like the fallback render pass, and its second holds the swapchain image.
+ */
+void VulkanApplication::createPresentPipeline() {
+    // Swapchain image layout
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &binding;
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &presentSetLayout) != VK_SUCCESS)
+        throw std::runtime_error("ERR::VULKAN::CREATE_PRESENT_PIPELINE::DESCRIPTOR_SET_LAYOUT_CREATION_FAILED");
+
+    // Pipeline layout
+    VkDescriptorSetLayout setLayouts[] = { graphicsBundle.descriptorSetLayout, presentSetLayout };
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 2;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &presentPipelineLayout) != VK_SUCCESS)
+        throw std::runtime_error("ERR::VULKAN::CREATE_PRESENT_PIPELINE::PIPELINE_LAYOUT_CREATION_FAILED");
+
+    // Pipeline
+    auto presentShaderCode = loadShader("present.spv");
+    VkShaderModule presentShaderModule = createShaderModule(presentShaderCode);
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.layout = presentPipelineLayout;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = presentShaderModule;
+    pipelineInfo.stage.pName = "main";
+
+    if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &presentPipeline) != VK_SUCCESS)
+        throw std::runtime_error("ERR::VULKAN::CREATE_PRESENT_PIPELINE::PIPELINE_CREATION_FAILED");
+    vkDestroyShaderModule(device, presentShaderModule, nullptr);
+
+    createPresentDescriptorSets();
+}
+
+/**
+ *  Creates a descriptor set for every swapchain image, for the present kernel to store to.
+ *  Called again whenever the swapchain is recreated, the pool goes with the old swapchain (see cleanupSwapChain).
+ */
+void VulkanApplication::createPresentDescriptorSets() {
+    presentDescriptorSets.clear();
+    if (!directPresent) return;
+
+    uint32_t imageCount = (uint32_t)swapChainImageViews.size();
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSize.descriptorCount = imageCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = imageCount;
+
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &presentDescriptorPool) != VK_SUCCESS)
+        throw std::runtime_error("ERR::VULKAN::CREATE_PRESENT_DESCRIPTOR_SETS::POOL_CREATION_FAILED");
+
+    std::vector<VkDescriptorSetLayout> layouts(imageCount, presentSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = presentDescriptorPool;
+    allocInfo.descriptorSetCount = imageCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    presentDescriptorSets.resize(imageCount);
+    if (vkAllocateDescriptorSets(device, &allocInfo, presentDescriptorSets.data()) != VK_SUCCESS)
+        throw std::runtime_error("ERR::VULKAN::CREATE_PRESENT_DESCRIPTOR_SETS::ALLOCATION_FAILED");
+
+    for (uint32_t i = 0; i < imageCount; i++) {
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        imageInfo.imageView = swapChainImageViews[i];
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = presentDescriptorSets[i];
+        write.dstBinding = 0;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        write.descriptorCount = 1;
+        write.pImageInfo = &imageInfo;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    }
+}
+
+/**
+ *  Records the present kernel, which exposes, tonemaps and upscales the output image straight into a swapchain image.
+ *  Takes the place of the fallback render pass when the swapchain allows it (see chooseDirectPresentFormat).
+ *
+ *  @param commandBuffer The graphics command buffer.
+ *  @param imageIndex Index of the swapchain image to present.
+ */
+void VulkanApplication::recordDirectPresent(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    // (The swapchain image's old contents are discarded, and the wait for it is at the compute stage, see drawFrame)
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = swapChainImages[imageIndex];
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkDescriptorSet descriptorSets[] = { graphicsBundle.descriptorSets[currentFrame], presentDescriptorSets[imageIndex] };
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, presentPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, presentPipelineLayout, 0, 2, descriptorSets, 0, nullptr);
+    vkCmdDispatch(commandBuffer, (swapChainExtent.width + 15) / 16, (swapChainExtent.height + 15) / 16, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
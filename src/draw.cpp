@@ -1,44 +1,55 @@
 #include "vulkanApplication.h"
 
-void VulkanApplication::drawFrame() {
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-    // --- Compute
-    // Wait for previous compute iteration
-    VkResult res = vkWaitForFences(device, 1, &computeInFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-    if (res != VK_SUCCESS)
-        throw std::runtime_error("ERR::VULKAN::DRAW_FRAME::UNEXPECTED_WAIT_ERROR");
-
-    // Reset fences before commiting new commands
-    vkResetFences(device, 1, &computeInFlightFences[currentFrame]);
-
-    vkResetCommandBuffer(computeCommandBuffers[currentFrame], 0);
-    recordComputeCommandBuffer(computeCommandBuffers[currentFrame]);
-
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &computeCommandBuffers[currentFrame];
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &computeFinishedSemaphores[currentFrame];
+/**
+ *  Writes this frame's state to the mapped memory of its slot, which the pre-recorded command buffers read.
+ *  (Written straight to the slot's mapped copies, so the parameters' version, and the accumulation, are left alone)
+ */
+void VulkanApplication::writeFrameState() {
+    memcpy(computeBundle.bufferMemories[b_frame].buffersMapped[currentFrame], &frame, sizeof(RTFrame));
+
+    // Hand the previous frame's camera to the temporal pass
+    RTReprojection reprojection{ previousLocalToWorld, previousScreenSize };
+    memcpy(computeBundle.bufferMemories[b_reprojection].buffersMapped[currentFrame], &reprojection, sizeof(reprojection));
+    previousLocalToWorld = frame.localToWorld;
+    previousScreenSize = glm::vec2(traceExtent.width, traceExtent.height);
+
+    RTPresent present{ glm::vec2(traceExtent.width, traceExtent.height), exposure, tonemap };
+    memcpy(graphicsBundle.bufferMemories[1].buffersMapped[currentFrame], &present, sizeof(present));
+}
 
-    if (vkQueueSubmit(computeQueue, 1, &submitInfo, computeInFlightFences[currentFrame]) != VK_SUCCESS)
-        throw std::runtime_error("ERR::VULKAN::DRAW_FRAME::SUBMIT_COMPUTE_QUEUE_FAILED");
-    
-    // --- Graphics
+void VulkanApplication::drawFrame() {
     /*  // MODEL
-        - Wait for the previous frame to finish
+        - Wait for the frame which last used this slot to finish, on both queues (the only CPU wait)
         - Acquire an image from the swap chain
-        - Record a command buffer which draws the scene onto that image
-        - Submit the recorded command buffer
+        - Write this frame's state to the slot's mapped memory
+        - Submit the compute work, which signals the compute timeline
+        - Submit a command buffer which draws the traced image onto the swap chain image,
+          once the compute timeline reaches this frame, and signals the graphics timeline
+      (The command buffers are recorded once per slot, and per swap chain image, and only recorded again when they change)
         - Present the swap chain image
+      (With an async compute family, the next frame's compute work runs while this frame is drawn and presented)
     */
+    uint64_t thisFrame = frameNumber + 1;
+
+    // Wait for the frame which last used this slot (no timeout)
+    if (thisFrame > framesInFlight) {
+        VkSemaphore timelines[] = { computeTimeline, graphicsTimeline };
+        uint64_t values[] = { thisFrame - framesInFlight, thisFrame - framesInFlight };
 
-    // Wait for previous frame to finish (CPU fence, no timeout)
-    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 2;
+        waitInfo.pSemaphores = timelines;
+        waitInfo.pValues = values;
+
+        if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+            throw std::runtime_error("ERR::VULKAN::DRAW_FRAME::UNEXPECTED_WAIT_ERROR");
+    }
 
     // Fetch image from swapchain
+    // (Before submitting anything, so that a frame is either submitted whole or not at all)
     uint32_t imageIndex;
-    res = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    VkResult res = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
 
     if (res == VK_ERROR_OUT_OF_DATE_KHR) {
         // If the swapchain was out of date for presentation, cancel presentation and recreate it
@@ -48,45 +59,92 @@ void VulkanApplication::drawFrame() {
     if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR)
         throw std::runtime_error("failed to acquire swap chain image!");
 
-    // Reset fence right before we are about to record command buffer
-    vkResetFences(device, 1, &inFlightFences[currentFrame]);
+    // --- Compute
+    // Time the compute work which last used this slot (see updateTraceExtent), and see how many wavefront rounds it needed
+    readFrameTimestamps();
+    readWavefrontRounds();
+    writeFrameState();
+
+    ComputeCommandsKey key = computeCommandsKey();
+    if (!(computeCommandsKeys[currentFrame] == key)) {
+        vkResetCommandBuffer(computeCommandBuffers[currentFrame], 0);
+        recordComputeCommandBuffer(computeCommandBuffers[currentFrame]);
+        computeCommandsKeys[currentFrame] = key;
+    }
 
-    // Record command buffer
-    //make sure its empty
-    vkResetCommandBuffer(graphicsCommandBuffers[currentFrame], 0);
-    //rerecord
-    recordGraphicsCommandBuffer(graphicsCommandBuffers[currentFrame], imageIndex);
+    VkTimelineSemaphoreSubmitInfo computeTimelineInfo{};
+    computeTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    computeTimelineInfo.signalSemaphoreValueCount = 1;
+    computeTimelineInfo.pSignalSemaphoreValues = &thisFrame;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &computeTimelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &computeCommandBuffers[currentFrame];
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &computeTimeline;
+
+    if (vkQueueSubmit(computeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        throw std::runtime_error("ERR::VULKAN::DRAW_FRAME::SUBMIT_COMPUTE_QUEUE_FAILED");
+
+    // --- Graphics
+    // Record command buffer, unless it already is
+    uint32_t graphicsIndex = currentFrame * (uint32_t)swapChainImages.size() + imageIndex;
+    if (graphicsCommandsVersions[graphicsIndex] != commandsVersion) {
+        //make sure its empty
+        vkResetCommandBuffer(graphicsCommandBuffers[graphicsIndex], 0);
+        //rerecord
+        recordGraphicsCommandBuffer(graphicsCommandBuffers[graphicsIndex], imageIndex);
+        graphicsCommandsVersions[graphicsIndex] = commandsVersion;
+    }
 
     // Submit command buffer
+    // (The timeline values of the binary semaphores are ignored)
+    VkSemaphore waitSemaphores[] = { computeTimeline, imageAvailableSemaphores[currentFrame] };
+    uint64_t waitValues[] = { thisFrame, 0 };
+    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+    if (directPresent) {
+        // (The present kernel both reads the traced image and writes the swap chain image)
+        waitStages[0] = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        waitStages[1] = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    }
+
+    // Tell Vulkan which semaphores to signal once command buffer is done executing
+    VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame], graphicsTimeline };
+    uint64_t signalValues[] = { 0, thisFrame };
+
+    VkTimelineSemaphoreSubmitInfo graphicsTimelineInfo{};
+    graphicsTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    graphicsTimelineInfo.waitSemaphoreValueCount = 2;
+    graphicsTimelineInfo.pWaitSemaphoreValues = waitValues;
+    graphicsTimelineInfo.signalSemaphoreValueCount = 2;
+    graphicsTimelineInfo.pSignalSemaphoreValues = signalValues;
+
     submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-    VkSemaphore waitSemaphores[] = { computeFinishedSemaphores[currentFrame], imageAvailableSemaphores[currentFrame] };
-    //for now, there is risk of vertex shader running before img available
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+    submitInfo.pNext = &graphicsTimelineInfo;
     submitInfo.waitSemaphoreCount = 2;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &graphicsCommandBuffers[currentFrame];
-
-    // Tell Vulkan which semaphores to signal once command buffer is done executing
-    VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pCommandBuffers = &graphicsCommandBuffers[graphicsIndex];
+    submitInfo.signalSemaphoreCount = 2;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
     // Submit command buffer to graphics queue!
     // (in the future there should be an array of many command buffers, not just one)
-    auto err = vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]);
+    auto err = vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
     if (err != VK_SUCCESS)
         throw std::runtime_error("failed to submit draw command buffer!");
+    frameNumber = thisFrame;
 
     // Presentation
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
 
     VkSwapchainKHR swapChains[] = { swapChain };
     presentInfo.swapchainCount = 1;
@@ -103,5 +161,5 @@ void VulkanApplication::drawFrame() {
         throw std::runtime_error("failed to present swap chain image!");
 
     // Advance to next frame
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    currentFrame = (currentFrame + 1) % framesInFlight;
 }
\ No newline at end of file
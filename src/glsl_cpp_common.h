@@ -31,17 +31,151 @@ START_BINDING( ComputeBindings )
 	b_blackholes	= 2,
 	b_image			= 3,
 	b_skybox		= 4,
-	b_torus			= 5
+	b_torus			= 5,
+	b_disks			= 6,
+	b_volumes		= 7,
+	b_volumeTexture	= 8,
+	b_volumeOccupancy = 9,
+	b_sdfNodes		= 10,
+	b_sdfObjects	= 11,
+	b_media			= 12,
+	b_refractionTexture = 13,
+	b_kerrDirection	= 14,
+	b_kerrExit		= 15,
+	b_accumulation	= 16,
+	b_moments		= 17,
+	b_tiles			= 18,
+	b_rayStates		= 19,
+	b_rayHits		= 20,
+	b_rayQueues		= 21,
+	b_workCounter	= 22,
+	b_hitBuffer		= 23,
+	b_history		= 24,
+	b_temporalPrior	= 25,
+	b_reprojection	= 26,
+	b_hitNormal		= 27,
+	b_denoise		= 28,
+	b_budgetMap		= 29,
+	b_frame			= 30,
+	b_wavefrontRounds = 31
 END_BINDING();
 
+// --- Volumes
+// (Every volume samples the same density/emission texture, which is split into a coarse occupancy grid of GRID_SIZE^3 cells)
+#define RT_VOLUME_TEXTURE_SIZE	64
+#define RT_VOLUME_GRID_SIZE		16
+
+// --- SDF node types
+// (Primitives push a distance onto the evaluation stack, operations pop two and push the result)
+#define RT_SDF_SPHERE			0	// params.x: radius
+#define RT_SDF_BOX				1	// params.xyz: half extents, params.w: corner rounding
+#define RT_SDF_TORUS			2	// params.x: major radius, params.y: minor radius (around the y-axis)
+#define RT_SDF_CAPSULE			3	// params.xyz: offset to the second end point, params.w: radius
+#define RT_SDF_UNION			16
+#define RT_SDF_INTERSECT		17
+#define RT_SDF_SUBTRACT			18	// (Second operand is removed from the first)
+#define RT_SDF_SMOOTH_UNION		19	// params.x: blend radius
+#define RT_SDF_MAX_STACK		8
+
+// --- Refractive media types
+// (Every medium is bounded by a sphere, outside of which n = 1)
+#define RT_MEDIUM_TEXTURE		0	// params.x: strength, scales the shared texture's n - 1 and gradient
+#define RT_MEDIUM_LUNEBURG		1	// params.x: strength, n = sqrt(1 + strength * (1 - r^2/R^2)), 1 for a classic Luneburg lens
+#define RT_MEDIUM_LINEAR		2	// params.xyz: gradient, params.w: n at the center (mirages)
+#define RT_MEDIUM_SHELL			3	// params.x: surface radius, params.y: n - 1 at the surface, params.z: scale height (atmospheres)
+#define RT_REFRACTION_TEXTURE_SIZE	32
+
+// --- Tiles
+// (The trace kernel processes one RT_TILE_SIZE^2 tile per workgroup, taken from the list built by classify.comp)
+#define RT_TILE_SIZE			32
+
+// --- Wavefront stages
+// (wavefront.comp is compiled once per stage with -DSTAGE=..., rays move between the bend, intersect and shade queues)
+#define WAVEFRONT_RAYGEN		0
+#define WAVEFRONT_BEND			1
+#define WAVEFRONT_INTERSECT		2
+#define WAVEFRONT_SHADE			3
+#define WAVEFRONT_RESOLVE		4
+#define WAVEFRONT_STAGE_COUNT	5
+#define WAVEFRONT_QUEUE_COUNT	3	// Bend, intersect and shade, each followed by the rest of the queue buffer in order
+#define WAVEFRONT_GROUP_SIZE	64
+
+// --- Persistent threads
+// (persistent.comp keeps its workgroups alive, pulling batches of pixels from the listed tiles until none are left)
+#define PERSISTENT_GROUP_SIZE	64
+#define PERSISTENT_ORDER_ROWS	0	// Row by row within each tile
+#define PERSISTENT_ORDER_MORTON	1	// Along a Z-order curve within each tile, so batches cover compact blocks
+
+// --- Interleaved tracing
+// (While the view moves, only the pixels of one slot are traced every frame, rotating through the slots, and temporal.comp fills in the rest)
+// 2: checkerboard, 4: one pixel of every 2x2 block, in the order top-left, bottom-right, top-right, bottom-left
+#define INTERLEAVE_SLOT(x, y, interleave)	((interleave) == 4u ? 2u * (((x) ^ (y)) & 1u) + ((y) & 1u) : (interleave) == 2u ? ((x) + (y)) & 1u : 0u)
+
+// --- Sample budgets
+// (Weights of the user-supplied budget map, see budget.hpp)
+#define RT_BUDGET_MAP_SIZE		64
+
+// --- Tonemapping
+// (Applied to the HDR output image by the present pass, see shader.frag)
+#define TONEMAP_CLAMP			0	// None, colors above 1 clip
+#define TONEMAP_REINHARD		1	// Reinhard on luminance, keeps hues
+#define TONEMAP_ACES			2	// Narkowicz's fit of the ACES filmic curve
+#define TONEMAP_COUNT			3
+
+// --- Specialization constant IDs
+// (See specialization.hpp)
+#define SPEC_RAY_SUBDIVISIONS		0
+#define SPEC_CULL_FACE				1
+#define SPEC_RAY_STEP_RANDOMNESS	2
+#define SPEC_HAS_SPHERES			3
+#define SPEC_HAS_TORI				4
+#define SPEC_HAS_HOLES				5
+#define SPEC_GROUP_SIZE				6	// Workgroup width and height of the trace kernel, must divide RT_TILE_SIZE
+
+// --- First hits
+// (Written per pixel by the trace kernel for temporal reprojection, see temporal.comp)
+#define RT_HIT_NONE				0
+#define RT_HIT_STRAIGHT			1	// xyz: position of the first hit, reached along a (nearly) straight path
+#define RT_HIT_BENT				2	// xyz: position of the first hit, reached along a bent path
+#define RT_HIT_ESCAPED			3	// xyz: direction the ray escaped in
+#define RT_HIT_CAPTURED			4	// xyz: position where the ray was absorbed, without hitting anything first
+
+// --- Primitive ids
+// (Stored with the first hit's normal, so the denoiser doesn't blur across object edges)
+#define RT_PRIMITIVE_NONE		0u
+#define RT_PRIMITIVE_TORUS		1u
+#define RT_PRIMITIVE_DISK		2u
+#define RT_PRIMITIVE_SDF		3u
+#define RT_PRIMITIVE_SPHERE		4u
+#define RT_PRIMITIVE_ID(type, index)	(((type) << 16) | uint(index))
+
+// --- Metrics
+// (The compute shader is compiled once per metric with -DMETRIC=..., see metric.hpp for the matching C++ policies)
+#define METRIC_NEWTONIAN		0
+#define METRIC_SCHWARZSCHILD	1
+#define METRIC_KERR				2
+
+// --- Kerr transfer tables
+// (Rays entering the sphere of KERR_LUT_RADIUS (in units of M = rs/2) are mapped straight to their exit, see kerr.hpp)
+#define KERR_LUT_RADIUS			4.5
+#define KERR_LUT_SIZE_PSI		64	// Azimuth of the impact vector around the incoming direction
+#define KERR_LUT_SIZE_B			64	// Impact parameter, relative to the sphere
+#define KERR_LUT_SIZE_THETA		32	// Angle between the incoming direction and the spin axis
+
 // --- Structs
 /**
  *	Struct containing information which should be updated every frame.
+ *	Written to a mapped UBO each frame, so the command buffers can be recorded once (see drawFrame).
  */
 struct RTFrame {
 	a16 vec3 cameraPos;
 	a16 mat4 localToWorld;
 	a16 int frameNumber;
+	int		accumulatedFrames;	// Frames accumulated since the view last changed, 0 restarts the accumulation
+	vec2	traceSize;			// Part of the images traced this frame, in texels (see updateTraceExtent)
+	uint	raysPerFrag;		// Rays traced per pixel this frame
+	uint	interleave;			// 1 traces every pixel, 2 or 4 only one of every 2 or 4 pixels (see INTERLEAVE_SLOT)
+	uint	interleavePhase;	// Slot of the pixels traced this frame, [0, interleave)
 };
 
 /**
@@ -50,20 +184,58 @@ struct RTFrame {
  */
 struct RTParams {
     // Camera
-    vec2    screenSize;
+    vec2    screenSize;             // Full resolution, the part traced each frame is RTFrame's traceSize
     float   fov,
             focusDistance;
 
     // Raytracing settings
     uint    maxBounces,
-            raysPerFrag;
+            raysPerFrag,            // Per frame, while accumulating a still view
+            interactiveRaysPerFrag; // Per frame, while the view is changing
     float   divergeStrength,
-            blackholePower;
+            blackholePower;         // (Scales the mass in the relativistic metrics, and the force in the Newtonian one)
 
     // Other
     uint    spheresCount,
             blackholesCount,
-			torusCount;
+			torusCount,
+			disksCount,
+			volumesCount,
+			sdfObjectsCount,
+			mediaCount;
+
+    // Preview
+    uint    previewMode;            // If non-zero, rays are bent once at their closest approach (thin lens) instead of stepped
+    float   previewFallbackRadius;  // Rays passing within this many horizon radii are still stepped
+
+    // Adaptive sampling
+    float   adaptiveThreshold;      // Tiles whose relative error (of the mean) is below this are considered converged
+    uint    adaptiveMinFrames;      // Every tile is traced for at least this many frames after the view changes
+
+    // Persistent threads
+    uint    persistentBatchSize,    // Pixels taken from the work counter at a time, a multiple of PERSISTENT_GROUP_SIZE
+            persistentOrder;        // See PERSISTENT_ORDER_*
+
+    // Temporal reprojection
+    uint    temporalEnabled;        // If non-zero, history is reprojected into the new view while the camera moves
+    float   temporalMaxHistory,     // Samples the reprojected history may count as, lower values adapt faster
+            temporalClampScale;     // Width of the neighbourhood clamp box, in standard deviations
+
+    // Denoiser
+    uint    denoiseIterations;      // A-trous iterations, each doubling the filter's reach, 0 disables the denoiser
+    float   denoiseColorSigma,      // Luminance differences are tolerated up to this many standard errors
+            denoiseNormalPower,     // Sharpness of the normal weight
+            denoiseDepthSigma;      // Relative depth differences are tolerated up to this much per pixel of reach
+
+    // Sample budgets
+    uint    budgetEnabled;          // If non-zero, pixels get a share of raysPerFrag by their weight, see SampleBudget
+    vec2    foveaCenter;            // Where the full budget is spent, in [0, 1] screen coordinates
+    float   foveaRadius,            // Radius of the full budget, relative to the screen height
+            foveaFalloff,           // Distance over which the budget falls off outside the fovea
+            budgetMin;              // Smallest weight any pixel gets
+
+    // Double buffered images
+    uint    imageHeight;            // Height of either half, as allocated, which stays put when the trace extent changes
 };
 
 /**
@@ -87,10 +259,13 @@ struct RTSphere {
 
 /**
  *	Struct for storing black hole information.
+ *	The radius is the Schwarzschild radius, and the spin is dimensionless (a/M, in [0, 1)).
+ *	Spin is only used by the Kerr variant, where a zero axis means no spin.
  */
 struct RTBlackhole {
 	a16 float	radius;
 	a16 vec3	center;
+	a16 vec4	spinAxis_spin;
 };
 
 /**
@@ -102,4 +277,119 @@ struct RTTorus {
 	a16 RTMaterial	material;
 };
 
+/**
+ *	Struct for storing thin accretion disk (annulus) information.
+ *	The emission of the material is scaled by (innerRadius / r)^falloff.
+ */
+struct RTDisk {
+	a16 vec4		center_innerRadius;
+	a16 vec4		normal_outerRadius;
+	a16 vec4		profile; // x: emission falloff exponent, y: skybox texture modulation strength
+	a16 RTMaterial	material;
+};
+
+/**
+ *	Struct for storing participating medium (volume) information.
+ *	The volume fills an axis-aligned box and samples the shared volume texture,
+ *	where rgb holds the emission color and a holds the density.
+ */
+struct RTVolume {
+	a16 vec4		boxMin_density;
+	a16 vec4		boxMax_emission;
+};
+
+/**
+ *	Struct for storing a single node of an SDF (CSG) tree.
+ *	Trees are stored in postfix order, see RT_SDF_* for the node types.
+ */
+struct RTSdfNode {
+	a16 vec4		position; // xyz: primitive center (or first end point of capsules)
+	a16 vec4		params;
+	a16 uint		type;
+};
+
+/**
+ *	Struct for storing SDF object information.
+ *	An object evaluates nodes [nodeStart, nodeStart + nodeCount) and is only marched within its bounding sphere.
+ */
+struct RTSdfObject {
+	a16 vec4		bounds; // xyz: center, w: radius
+	a16 uint		nodeStart;
+	uint			nodeCount;
+	a16 RTMaterial	material;
+};
+
+/**
+ *	Struct for storing gradient-index (refractive) medium information.
+ *	Light inside a medium curves towards higher n, see RT_MEDIUM_* for the types.
+ */
+struct RTMedium {
+	a16 vec4		center_radius;
+	a16 vec4		params;
+	a16 uint		type;
+};
+
+/**
+ *	Struct for storing the state of a ray in flight (wavefront tracing).
+ *	There is one per pixel, and stepDist is what remains of the ray's current segment.
+ */
+struct RTRayState {
+	a16 vec4		origin_stepDist;
+	a16 vec3		dir;
+	uint			seed;
+	a16 vec4		accel_divisions;
+	a16 vec4		incomingLight_alive; // w: 0 once the ray is absorbed
+	a16 vec4		rayColor_grinSteps;  // w: steps taken inside refractive media, see CountStep
+	a16 vec4		firstHit;            // See RT_HIT_*, RT_HIT_NONE until the ray hits something
+	a16 vec4		firstHitNormal;      // w: primitive id
+	a16 vec4		initialDir;          // xyz: direction of the camera ray, to tell bent first hits apart
+};
+
+/**
+ *	Struct for storing the closest hit of a ray's current segment (wavefront tracing).
+ */
+struct RTRayHit {
+	a16 vec4		pos_dist;
+	a16 vec4		normal;
+	a16 RTMaterial	material;
+};
+
+/**
+ *	Header of a ray queue, whose first three words are the indirect dispatch arguments of the stage consuming it.
+ */
+struct RTQueue {
+	uint	dispatchX,
+			dispatchY,
+			dispatchZ,
+			count,
+			finished;	// Invocations of the consuming stage done reading the queue, the last one empties it (see PopRay)
+};
+
+/**
+ *	Struct for the push constants of the compute kernels, which tell the dispatches of a frame apart.
+ *	Constant for every dispatch, so they are recorded along with it.
+ */
+struct RTDispatch {
+	uint	wave;				// Wave of the wavefront kernels, [0, raysPerFrag)
+	uint	denoiseIteration;	// Iteration of the denoiser pass
+	uint	round;				// Bend/intersect/shade round of the wavefront kernels
+};
+
+/**
+ *	Struct for the UBO of the present pass.
+ */
+struct RTPresent {
+	vec2	traceSize;			// Part of the output image traced this frame, in texels (see updateTraceExtent)
+	float	exposure;			// In stops
+	uint	tonemap;			// See TONEMAP_*
+};
+
+/**
+ *	Struct for storing the camera of the previous frame, for temporal reprojection.
+ */
+struct RTReprojection {
+	a16 mat4		previousLocalToWorld;
+	vec2			previousScreenSize;		// Resolution the previous frame was traced at
+};
+
 #endif
\ No newline at end of file
@@ -74,8 +74,8 @@ void VulkanApplication::createRenderPass() {
  */
 void VulkanApplication::createGraphicsPipeline() {
     // Read shader code
-    auto vertShaderCode = readFile("../resources/shaders/vert.spv");
-    auto fragShaderCode = readFile("../resources/shaders/frag.spv");
+    auto vertShaderCode = loadShader("vert.spv");
+    auto fragShaderCode = loadShader("frag.spv");
 
     // Create shader modules
     // (Since the SPIR-V code is not made into machine code until the pipeline is created, these objects can be local and deleted)
@@ -205,8 +205,7 @@ void VulkanApplication::createGraphicsPipeline() {
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = 1;
     pipelineLayoutInfo.pSetLayouts = &graphicsBundle.descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+    // (The part of the compute image traced this frame, and how to tonemap it, are in a mapped UBO, see writeFrameState)
 
     if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &graphicsPipelineLayout) != VK_SUCCESS)
         throw std::runtime_error("ERR::VULKAN::CREATE_GRAPHICS_PIPELINE::PIPELINE_LAYOUT_CREATION_FAILED");
@@ -241,7 +240,7 @@ void VulkanApplication::createGraphicsPipeline() {
     //create graphics pipeline
     if (vkCreateGraphicsPipelines(
         device,
-        VK_NULL_HANDLE, // VkPipelineCache object for reusing data between pipeline creations
+        pipelineCache, // VkPipelineCache object for reusing data between pipeline creations (and runs)
         1,
         &pipelineInfo,
         nullptr,
@@ -288,57 +287,68 @@ void VulkanApplication::recordGraphicsCommandBuffer(VkCommandBuffer commandBuffe
     if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
         throw std::runtime_error("ERR::VULKAN::RECORD_COMMAND_BUFFER::COMMAND_BUFFER_BEGIN_FAILED");
 
-    // Start render pass
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = renderPass;
-    renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex]; // Which image in swapchain to draw to
-    renderPassInfo.renderArea.offset = { 0, 0 };
-    renderPassInfo.renderArea.extent = swapChainExtent;
-
-    // Set which clear values VK_ATTACHMENT_LOAD_OP_CLEAR will use
-    // Needs to be in the same order as attachments!
-    std::array<VkClearValue, 1> clearValues;
-    clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
-
-    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());;
-    renderPassInfo.pClearValues = clearValues.data();
-
-    // Begin render pass
-    vkCmdBeginRenderPass(
-        commandBuffer,
-        &renderPassInfo,
-        // VK_SUBPASS_CONTENTS_INLINE - Embed commands into primary controll buffer (no secondary command buffer executed)
-        // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS - Execute commands from secondary command buffer.
-        VK_SUBPASS_CONTENTS_INLINE
-    );
-
-    // Bind pipeline
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelineLayout, 0, 1, &graphicsBundle.descriptorSets[currentFrame], 0, nullptr);
-
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(swapChainExtent.width);
-    viewport.height = static_cast<float>(swapChainExtent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-    VkRect2D scissor{};
-    scissor.offset = { 0, 0 };
-    scissor.extent = swapChainExtent;
-    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-    //VkDeviceSize offsets[] = { 0 };
-    //vkCmdBindVertexBuffers(commandBuffer, 0, 1, &shaderStorageBuffers[currentFrame], offsets);
-
-    // Draw
-    vkCmdDraw(commandBuffer, 6, 1, 0, 0);
-
-    // End render pass
-    vkCmdEndRenderPass(commandBuffer);
+    // Take the traced image from the compute family
+    recordOutputTransfer(commandBuffer, true, false);
+
+    // Present straight from the present kernel when the swapchain allows it, otherwise through the render pass
+    if (directPresent) {
+        recordDirectPresent(commandBuffer, imageIndex);
+    } else {
+        // Start render pass
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex]; // Which image in swapchain to draw to
+        renderPassInfo.renderArea.offset = { 0, 0 };
+        renderPassInfo.renderArea.extent = swapChainExtent;
+
+        // Set which clear values VK_ATTACHMENT_LOAD_OP_CLEAR will use
+        // Needs to be in the same order as attachments!
+        std::array<VkClearValue, 1> clearValues;
+        clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());;
+        renderPassInfo.pClearValues = clearValues.data();
+
+        // Begin render pass
+        vkCmdBeginRenderPass(
+            commandBuffer,
+            &renderPassInfo,
+            // VK_SUBPASS_CONTENTS_INLINE - Embed commands into primary controll buffer (no secondary command buffer executed)
+            // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS - Execute commands from secondary command buffer.
+            VK_SUBPASS_CONTENTS_INLINE
+        );
+
+        // Bind pipeline
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelineLayout, 0, 1, &graphicsBundle.descriptorSets[currentFrame], 0, nullptr);
+
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(swapChainExtent.width);
+        viewport.height = static_cast<float>(swapChainExtent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor{};
+        scissor.offset = { 0, 0 };
+        scissor.extent = swapChainExtent;
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        //VkDeviceSize offsets[] = { 0 };
+        //vkCmdBindVertexBuffers(commandBuffer, 0, 1, &shaderStorageBuffers[currentFrame], offsets);
+
+        // Draw
+        vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+
+        // End render pass
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+    // Hand it back for the compute work which next uses this frame's slot
+    recordOutputTransfer(commandBuffer, false, true);
 
     // Finish recording to command buffer
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
@@ -0,0 +1,56 @@
+#include "vulkanApplication.h"
+
+#include <cstdlib>
+
+
+#ifdef SHADER_HOT_RELOAD
+/**
+ *  Gets the time of the latest change to any shader source.
+ */
+static std::filesystem::file_time_type newestShaderSourceTime() {
+    std::error_code error;
+    auto newest = std::filesystem::last_write_time(SHADER_COMMON_HEADER, error);
+    for (const auto& entry : std::filesystem::directory_iterator(SHADER_SOURCE_DIR, error)) {
+        auto time = entry.last_write_time(error);
+        if (!error && time > newest) newest = time;
+    }
+    return newest;
+}
+#endif
+
+/**
+ *  Checks whether any shader source changed, and if so recompiles the shaders and swaps in new compute pipelines.
+ *  Only does anything in builds configured with SHADER_HOT_RELOAD, and polls at most twice a second.
+ *  If compilation fails, the current pipelines are kept.
+ *
+ *  @return Whether the compute pipelines were swapped.
+ */
+bool VulkanApplication::pollShaderChanges() {
+#ifdef SHADER_HOT_RELOAD
+    double now = glfwGetTime();
+    if (now - lastShaderPoll < 0.5) return false;
+    lastShaderPoll = now;
+
+    auto newest = newestShaderSourceTime();
+    if (shaderSourceTime == std::filesystem::file_time_type{}) shaderSourceTime = newest;
+    if (newest <= shaderSourceTime) return false;
+    shaderSourceTime = newest;
+
+    // Recompile through the build's own shader target
+    printf("Shader sources changed, recompiling...\n");
+    std::string command = "\"" SHADER_CMAKE_COMMAND "\" --build \"" SHADER_BUILD_DIR "\" --target shaders";
+    if (std::system(command.c_str()) != 0) {
+        printf("Shader compilation failed, keeping the current pipelines\n");
+        return false;
+    }
+
+    // Swap the pipelines
+    vkDeviceWaitIdle(device);
+    destroyComputeKernels();
+    createComputeKernels();
+    printf("Compute pipelines reloaded\n");
+    return true;
+#else
+    return false;
+#endif
+}
@@ -30,6 +30,8 @@ bool inline hasStencilComponent(VkFormat format) {
  *  @param device The Vulkan logical device.
  *  @param image An empty variable for the image.
  *  @param imageMemory An empty variable for the image memory.
+ *  @param depth The depth of the image.
+ *  @param imageType The type of image, i.e. VK_IMAGE_TYPE_3D for volumes (even those with a depth of 1).
  */
 void inline createImage(
     uint32_t                width,
@@ -42,15 +44,17 @@ void inline createImage(
     VkPhysicalDevice        physicalDevice,
     VkDevice                device,
     VkImage                 & image,
-    VkDeviceMemory          & imageMemory
+    VkDeviceMemory          & imageMemory,
+    uint32_t                depth = 1,
+    VkImageType             imageType = VK_IMAGE_TYPE_2D
 ) {
     // Create Vulkan image
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.imageType = imageType;
     imageInfo.extent.width = width;
     imageInfo.extent.height = height;
-    imageInfo.extent.depth = 1;
+    imageInfo.extent.depth = depth;
     imageInfo.mipLevels = mipLevels;
     imageInfo.arrayLayers = 1;
     imageInfo.format = format;
@@ -88,6 +92,7 @@ void inline createImage(
  *  @param aspectFlags Which aspects are included in the view.
  *  @param mipLevels How many mipmap levels the image has.
  *  @param device The Vulkan logical device.
+ *  @param viewType The type of view, i.e. VK_IMAGE_VIEW_TYPE_3D for volumes.
  * 
  *  @return The image view.
  */
@@ -96,7 +101,8 @@ VkImageView inline createImageView(
     VkFormat            format,
     VkImageAspectFlags  aspectFlags,
     uint32_t            mipLevels,
-    VkDevice            device
+    VkDevice            device,
+    VkImageViewType     viewType = VK_IMAGE_VIEW_TYPE_2D
 ) {
     // Create image view struct
     VkImageViewCreateInfo createInfo{};
@@ -104,7 +110,7 @@ VkImageView inline createImageView(
     createInfo.image = image;
 
     // Other types include: 1D and 3D textures, cubemaps
-    createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    createInfo.viewType = viewType;
     createInfo.format = format;
 
     // Use default mapping explicitly
@@ -130,21 +136,25 @@ VkImageView inline createImageView(
 
 /**
  *  Creates the sampler for the texture.
+ *  Textures repeat by default, volumes should use VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE.
+ *  The U axis may be addressed differently, e.g. to wrap a periodic coordinate (VK_SAMPLER_ADDRESS_MODE_MAX_ENUM: as addressMode).
  */
 void inline createSampler (
 
     VkPhysicalDevice    physicalDevice,
     VkDevice            device,
-    VkSampler           & sampler
+    VkSampler           & sampler,
+    VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+    VkSamplerAddressMode addressModeU = VK_SAMPLER_ADDRESS_MODE_MAX_ENUM
 ) {
     // Create sampler
     VkSamplerCreateInfo samplerInfo{};
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
     samplerInfo.magFilter = VK_FILTER_LINEAR;
     samplerInfo.minFilter = VK_FILTER_LINEAR;
-    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeU = addressModeU != VK_SAMPLER_ADDRESS_MODE_MAX_ENUM ? addressModeU : addressMode;
+    samplerInfo.addressModeV = addressMode;
+    samplerInfo.addressModeW = addressMode;
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.minLod = 0.0f; // To see effects: try static_cast<float>(mipLevels / 2);
     samplerInfo.maxLod = 1;
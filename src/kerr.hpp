@@ -0,0 +1,286 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "glsl_cpp_common.h"
+#include "tracer.hpp"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <algorithm>
+
+
+/**
+ *  Transfer tables for light passing close to a Kerr black hole, ready to be uploaded.
+ *  Both tables are indexed by (psi, b, theta) of a ray entering the sphere of radius KERR_LUT_RADIUS * M,
+ *  and are expressed in the ray's local frame (u, v, d), where d is the incoming direction
+ *  and u is the spin axis made perpendicular to d.
+ */
+struct KerrLUT {
+    std::vector<uint64_t> direction; // RGBA16F, rgb: outgoing direction, a: 1 if captured
+    std::vector<uint64_t> exit;      // RGBA16F, rgb: exit position on the unit sphere
+};
+
+/**
+ *  Header of a cached Kerr transfer table, used to tell whether the cache is still valid.
+ */
+struct KerrLUTHeader {
+    uint32_t    magic = 0x4B4C5554, // "KLUT"
+                version = 2,
+                sizePsi = KERR_LUT_SIZE_PSI,
+                sizeB = KERR_LUT_SIZE_B,
+                sizeTheta = KERR_LUT_SIZE_THETA;
+    float       spin = 0.f,
+                radius = KERR_LUT_RADIUS;
+
+    bool operator==(const KerrLUTHeader& other) const {
+        return magic == other.magic && version == other.version
+            && sizePsi == other.sizePsi && sizeB == other.sizeB && sizeTheta == other.sizeTheta
+            && spin == other.spin && radius == other.radius;
+    }
+};
+
+/**
+ *  Traces light along an exact Kerr null geodesic, in units where M = 1 and with the spin axis along +y.
+ *  The ray is integrated in Boyer-Lindquist coordinates over Mino time, from its conserved energy (1), angular momentum and Carter constant.
+ *  (The second order radial and polar equations are used, so turning points need no special care)
+ *  Positions are mapped through the flat (oblate spheroidal) embedding of the coordinates, and directions are as seen by a locally
+ *  non-rotating observer, so that far from the hole both match the straight rays of the weak-field KerrMetric.
+ *
+ *  @param spin The dimensionless spin of the hole, [0, 1).
+ *  @param origin The origin of the ray, outside the ergosphere.
+ *  @param dir The direction of the ray.
+ *  @param escapeRadius Distance from the hole beyond which an outgoing ray has left.
+ *  @param maxSteps Steps after which the ray is given up on.
+ *
+ *  @return The result.
+ */
+TraceResult inline traceKerrGeodesic(float spin, glm::vec3 origin, glm::vec3 dir, float escapeRadius, int maxSteps) {
+    struct State { double r, theta, phi, pr, ptheta; };
+
+    const double a = glm::clamp((double)spin, 0.0, 0.999),
+                 a2 = a * a,
+                 horizon = 1.0 + std::sqrt(1.0 - a2);
+
+    // (Boyer-Lindquist axes: x along world x, y along world -z and z along the spin axis, world y)
+    auto toCoordinates = [](glm::vec3 v) { return glm::dvec3(v.x, -v.z, v.y); };
+    auto toWorld = [](glm::dvec3 v) { return glm::vec3(v.x, v.z, -v.y); };
+    auto embed = [&](const State& s) {
+        double rho = std::sqrt(s.r * s.r + a2);
+        return glm::dvec3(rho * std::sin(s.theta) * std::cos(s.phi), rho * std::sin(s.theta) * std::sin(s.phi), s.r * std::cos(s.theta));
+    };
+    // (Unit vectors along r, theta and phi, where the phi one carries the sign of sin(theta) as the metric does)
+    auto basis = [&](const State& s, glm::dvec3& er, glm::dvec3& etheta, glm::dvec3& ephi) {
+        double rho = std::sqrt(s.r * s.r + a2),
+               st = std::sin(s.theta), ct = std::cos(s.theta),
+               sp = std::sin(s.phi), cp = std::cos(s.phi),
+               sigmaRoot = std::sqrt(s.r * s.r + a2 * ct * ct);
+        er = glm::dvec3(s.r * st * cp, s.r * st * sp, rho * ct) / sigmaRoot;
+        etheta = glm::dvec3(rho * ct * cp, rho * ct * sp, -s.r * st) / sigmaRoot;
+        ephi = glm::dvec3(-sp, cp, 0.0);
+    };
+
+    // Find the coordinates of the origin
+    glm::dvec3 p = toCoordinates(origin), d = glm::normalize(toCoordinates(dir));
+    double k = glm::dot(p, p) - a2;
+    State state{};
+    state.r = std::sqrt(0.5 * (k + std::sqrt(k * k + 4.0 * a2 * p.z * p.z)));
+    state.theta = std::acos(glm::clamp(p.z / state.r, -1.0, 1.0));
+    state.phi = std::atan2(p.y, p.x);
+
+    // Find the constants of motion from the direction seen by the local observer
+    glm::dvec3 er, etheta, ephi;
+    basis(state, er, etheta, ephi);
+    double  r = state.r, st = std::sin(state.theta), ct = std::cos(state.theta),
+            sigma = r * r + a2 * ct * ct,
+            delta = r * r - 2.0 * r + a2,
+            bigA = (r * r + a2) * (r * r + a2) - a2 * delta * st * st,
+            omega = 2.0 * a * r / bigA,
+            eNu = std::sqrt(sigma * delta / bigA),
+            ePsi = std::sqrt(bigA / sigma) * st,
+            localEnergy = 1.0 / (eNu + omega * ePsi * glm::dot(d, ephi)),
+            L = ePsi * localEnergy * glm::dot(d, ephi);
+    state.pr = std::sqrt(sigma * delta) * localEnergy * glm::dot(d, er);
+    state.ptheta = std::sqrt(sigma) * localEnergy * glm::dot(d, etheta);
+    double  Q = state.ptheta * state.ptheta + ct * ct * (L * L / (st * st) - a2),
+            K = Q + (L - a) * (L - a);
+
+    // Mino time derivatives, d/dlambda = Sigma d/dtau
+    auto derivative = [&](const State& s) {
+        double sinTheta = std::sin(s.theta), cosTheta = std::cos(s.theta);
+        if (std::abs(sinTheta) < 1e-6) sinTheta = std::copysign(1e-6, sinTheta);
+        double sDelta = s.r * s.r - 2.0 * s.r + a2,
+               P = s.r * s.r + a2 - a * L;
+        return State {
+            s.pr,
+            s.ptheta,
+            a * P / sDelta - a + L / (sinTheta * sinTheta),
+            0.5 * (4.0 * s.r * P - (2.0 * s.r - 2.0) * K),
+            0.5 * (-2.0 * a2 * cosTheta * sinTheta + 2.0 * L * L * cosTheta / (sinTheta * sinTheta * sinTheta))
+        };
+    };
+    auto advance = [](const State& s, const State& ds, double h) {
+        return State { s.r + ds.r * h, s.theta + ds.theta * h, s.phi + ds.phi * h, s.pr + ds.pr * h, s.ptheta + ds.ptheta * h };
+    };
+
+    TraceResult result { origin, glm::normalize(dir), false, 0 };
+    for (; result.steps < maxSteps; result.steps++) {
+        if (state.r < horizon * 1.01) { result.captured = true; break; }
+        glm::dvec3 pos = embed(state);
+        if (glm::dot(pos, pos) > (double)escapeRadius * escapeRadius && state.pr > 0.0) break;
+
+        // (Steps are about 0.005 + 0.02 (r - horizon) long, and turn the ray by at most 0.02 radians)
+        State   k1 = derivative(state);
+        double  stepSigma = state.r * state.r + a2 * std::cos(state.theta) * std::cos(state.theta),
+                h = std::min((0.005 + 0.02 * (state.r - horizon)) / stepSigma, 0.02 / (std::abs(k1.theta) + std::abs(k1.phi) + 1e-9));
+        State   k2 = derivative(advance(state, k1, 0.5 * h)),
+                k3 = derivative(advance(state, k2, 0.5 * h)),
+                k4 = derivative(advance(state, k3, h));
+        state = State {
+            state.r + h / 6.0 * (k1.r + 2.0 * k2.r + 2.0 * k3.r + k4.r),
+            state.theta + h / 6.0 * (k1.theta + 2.0 * k2.theta + 2.0 * k3.theta + k4.theta),
+            state.phi + h / 6.0 * (k1.phi + 2.0 * k2.phi + 2.0 * k3.phi + k4.phi),
+            state.pr + h / 6.0 * (k1.pr + 2.0 * k2.pr + 2.0 * k3.pr + k4.pr),
+            state.ptheta + h / 6.0 * (k1.ptheta + 2.0 * k2.ptheta + 2.0 * k3.ptheta + k4.ptheta)
+        };
+
+        // Put the momenta back on (dr/dlambda)^2 = R(r) and (dtheta/dlambda)^2 = Theta(theta), away from turning points
+        // (Far from the hole, tiny relative errors in R would otherwise add up to large ones at the closest approach)
+        double  P = state.r * state.r + a2 - a * L,
+                radial = P * P - (state.r * state.r - 2.0 * state.r + a2) * K,
+                cosTheta = std::cos(state.theta),
+                polar = Q + cosTheta * cosTheta * (a2 - L * L / std::max(1.0 - cosTheta * cosTheta, 1e-12));
+        if (radial > 0.01 * state.pr * state.pr) state.pr = std::copysign(std::sqrt(radial), state.pr);
+        if (polar > 0.01 * state.ptheta * state.ptheta) state.ptheta = std::copysign(std::sqrt(polar), state.ptheta);
+    }
+
+    // Map the final state back, with the direction seen by the local observer there
+    r = state.r; st = std::sin(state.theta); ct = std::cos(state.theta);
+    sigma = r * r + a2 * ct * ct;
+    delta = std::max(r * r - 2.0 * r + a2, 1e-9);
+    bigA = (r * r + a2) * (r * r + a2) - a2 * delta * st * st;
+    ePsi = std::sqrt(bigA / sigma) * st;
+    if (std::abs(ePsi) < 1e-9) ePsi = std::copysign(1e-9, ePsi);
+
+    basis(state, er, etheta, ephi);
+    glm::dvec3 exitDir = state.pr / std::sqrt(sigma * delta) * er + state.ptheta / std::sqrt(sigma) * etheta + L / ePsi * ephi;
+    result.position = toWorld(embed(state));
+    result.direction = glm::normalize(toWorld(exitDir));
+    return result;
+}
+
+/**
+ *  Bakes the Kerr transfer tables by tracing one exact geodesic per texel, in units where M = 1.
+ *  (RTParams::blackholePower only scales M, so the same tables serve every power)
+ *  Work is split across all hardware threads, by theta slice.
+ *
+ *  @param spin The dimensionless spin of the hole, [0, 1).
+ *
+ *  @return The baked tables.
+ */
+KerrLUT inline bakeKerrLUT(float spin) {
+    const int   sizePsi = KERR_LUT_SIZE_PSI,
+                sizeB = KERR_LUT_SIZE_B,
+                sizeTheta = KERR_LUT_SIZE_THETA;
+    const float radius = KERR_LUT_RADIUS,
+                pi = 3.14159265358979f;
+
+    KerrLUT lut{};
+    lut.direction.resize(sizePsi * sizeB * sizeTheta);
+    lut.exit.resize(sizePsi * sizeB * sizeTheta);
+
+    // (Rays that are still orbiting once the steps run out are counted as captured)
+    const glm::vec3 axis = glm::vec3(0.f, 1.f, 0.f);
+    const int       maxSteps = 8192;
+
+    auto bakeSlice = [&](int theta) {
+        float       angle = (theta + 0.5f) / sizeTheta * pi;
+        glm::vec3   d = glm::vec3(std::sin(angle), std::cos(angle), 0.f),
+                    u = glm::normalize(axis - glm::dot(axis, d) * d),
+                    v = glm::cross(d, u);
+
+        for (int b = 0; b < sizeB; b++)
+        for (int psi = 0; psi < sizePsi; psi++) {
+            float       impact = (b + 0.5f) / sizeB * radius,
+                        azimuth = (psi + 0.5f) / sizePsi * 2.f * pi;
+            glm::vec3   impactVector = impact * (std::cos(azimuth) * u + std::sin(azimuth) * v),
+                        entry = impactVector - d * std::sqrt(radius * radius - impact * impact);
+
+            TraceResult result = traceKerrGeodesic(spin, entry, d, radius, maxSteps);
+            bool        captured = result.captured || result.steps >= maxSteps;
+            glm::vec3   exitDir = result.direction,
+                        exitPos = glm::normalize(result.position);
+
+            size_t i = psi + sizePsi * (b + sizeB * theta);
+            lut.direction[i] = glm::packHalf4x16(captured
+                ? glm::vec4(0.f, 0.f, 0.f, 1.f)
+                : glm::vec4(glm::dot(exitDir, u), glm::dot(exitDir, v), glm::dot(exitDir, d), 0.f));
+            lut.exit[i] = glm::packHalf4x16(glm::vec4(glm::dot(exitPos, u), glm::dot(exitPos, v), glm::dot(exitPos, d), 0.f));
+        }
+    };
+
+    std::vector<std::thread> threads;
+    int threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+    for (int t = 0; t < threadCount; t++)
+        threads.emplace_back([&, t]() {
+            for (int theta = t; theta < sizeTheta; theta += threadCount) bakeSlice(theta);
+        });
+    for (auto& thread : threads) thread.join();
+
+    return lut;
+}
+
+/**
+ *  Loads the Kerr transfer tables from disk, or bakes and caches them if the cache is missing or stale.
+ *  Failing to write the cache is not fatal, the tables are simply baked again next time.
+ *
+ *  @param spin The dimensionless spin of the hole, [0, 1).
+ *  @param cachePath Where the tables are cached.
+ *
+ *  @return The tables.
+ */
+KerrLUT inline loadKerrLUT(float spin, const std::string& cachePath = "../resources/cache/kerr_lut.bin") {
+    KerrLUTHeader expected{};
+    expected.spin = spin;
+    const size_t count = (size_t)KERR_LUT_SIZE_PSI * KERR_LUT_SIZE_B * KERR_LUT_SIZE_THETA;
+
+    // Try the cache
+    std::ifstream in(cachePath, std::ios::binary);
+    if (in.is_open()) {
+        KerrLUTHeader header{};
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (in && header == expected) {
+            KerrLUT lut{};
+            lut.direction.resize(count);
+            lut.exit.resize(count);
+            in.read(reinterpret_cast<char*>(lut.direction.data()), count * sizeof(uint64_t));
+            in.read(reinterpret_cast<char*>(lut.exit.data()), count * sizeof(uint64_t));
+            if (in) return lut;
+        }
+    }
+    in.close();
+
+    // Bake and cache
+    printf("Baking Kerr transfer tables (spin = %.3f)...\n", spin);
+    KerrLUT lut = bakeKerrLUT(spin);
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), error);
+    std::ofstream out(cachePath, std::ios::binary | std::ios::trunc);
+    if (out.is_open()) {
+        out.write(reinterpret_cast<const char*>(&expected), sizeof(expected));
+        out.write(reinterpret_cast<const char*>(lut.direction.data()), count * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char*>(lut.exit.data()), count * sizeof(uint64_t));
+    }
+    if (!out.is_open() || !out) printf("Could not cache Kerr transfer tables at %s\n", cachePath.c_str());
+
+    return lut;
+}
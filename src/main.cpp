@@ -7,11 +7,13 @@
 
 /**
  *	The main program.
+ *	Takes the runtime settings as "--key value" pairs, see loadRuntimeSettings.
  */
-int main() {
+int main(int argc, char** argv) {
     VulkanApplication app;
 
     try {
+        loadRuntimeSettings(argc, argv);
         app.run();
     }
     catch (const std::exception& e) {
@@ -51,7 +51,7 @@ public:
         // If the buffer is mapped, make it host visible and coherent
         if (isMapped) {
             props = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-            buffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+            buffersMapped.resize(framesInFlight);
         }
         // If the buffer is not mapped and has initial data, stage it
         else if (initialData.size() > 0) {
@@ -75,9 +75,9 @@ public:
         }
 
         // Create main buffers (and transfer data)
-        buffers.resize(MAX_FRAMES_IN_FLIGHT);
-        buffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        buffers.resize(framesInFlight);
+        buffersMemory.resize(framesInFlight);
+        for (size_t i = 0; i < framesInFlight; i++) {
             createBuffer( bufferSize, usage, props, physicalDevice, device, buffers[i], buffersMemory[i] );
 
             if (isMapped)
@@ -232,6 +232,7 @@ void inline copyBuffer(
  *  @param device The Vulkan logical device.
  *  @param commandPool The command pool to use.
  *  @param queue The queue to copy-command with.
+ *  @param depth Depth of the image region to copy to (for 3D images).
  */
 void inline copyBufferToImage(
     VkBuffer        buffer,
@@ -240,7 +241,8 @@ void inline copyBufferToImage(
     uint32_t        height,
     VkDevice        device,
     VkCommandPool   commandPool,
-    VkQueue         queue
+    VkQueue         queue,
+    uint32_t        depth = 1
 ) {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
 
@@ -259,7 +261,7 @@ void inline copyBufferToImage(
     region.imageExtent = {
         width,
         height,
-        1
+        depth
     };
 
     // Copy buffer to image
@@ -0,0 +1,119 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "glsl_cpp_common.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+// Metric policies
+// (Each policy mirrors a METRIC_* variant of the compute shader, and is resolved at compile time by Tracer<Metric>)
+
+/**
+ *  Newtonian-style inverse-square bending, as in the default shader variant.
+ */
+struct NewtonianMetric {
+    static constexpr int        id = METRIC_NEWTONIAN;
+    static constexpr const char *shaderName = "comp.spv";
+    static constexpr const char *variantSuffix = ""; // (Of the wavefront kernels, see createWavefrontPipelines)
+
+    /**
+     *  Calculates the acceleration of light at a given position.
+     *
+     *  @param pos The position of the light.
+     *  @param dir The (unit) direction of the light.
+     *  @param hole The black hole.
+     *  @param power Strength multiplier, as in RTParams::blackholePower.
+     *
+     *  @return The acceleration.
+     */
+    static glm::vec3 inline acceleration(glm::vec3 pos, glm::vec3 dir, const RTBlackhole& hole, float power) {
+        glm::vec3   dirToHole = hole.center - pos;
+        float       dist = glm::length(dirToHole),
+                    invDistSqr = 1.f / (dist * dist);
+        dirToHole /= dist;
+        return dirToHole * invDistSqr * power;
+    }
+
+    /**
+     *  Checks whether light at a given position has been captured by the black hole.
+     *  (Power only strengthens the force here, the relativistic metrics scale the mass by it instead)
+     */
+    static bool inline captured(glm::vec3 pos, const RTBlackhole& hole, float power) {
+        return glm::distance(pos, hole.center) < hole.radius;
+    }
+
+    /**
+     *  Gets the step distance at a given position, before any randomization.
+     */
+    static float inline safeStep(glm::vec3 pos, const RTBlackhole& hole, float power, float stepFactor) {
+        return 0.1f + stepFactor * glm::distance(pos, hole.center);
+    }
+};
+
+/**
+ *  Exact null geodesics around a non-rotating hole, where RTBlackhole::radius is the Schwarzschild radius at power 1.
+ *  Light obeys x'' = -3/2 rs h^2 x / r^5, with h = |x cross x'| the (conserved) angular momentum, and rs = radius * power.
+ */
+struct SchwarzschildMetric {
+    static constexpr int        id = METRIC_SCHWARZSCHILD;
+    static constexpr const char *shaderName = "comp_schwarzschild.spv";
+    static constexpr const char *variantSuffix = "_schwarzschild";
+
+    static glm::vec3 inline acceleration(glm::vec3 pos, glm::vec3 dir, const RTBlackhole& hole, float power) {
+        glm::vec3   offset = pos - hole.center,
+                    angularMomentum = glm::cross(offset, dir);
+        float       distSqr = glm::dot(offset, offset),
+                    rs = hole.radius * power;
+        return -1.5f * rs * glm::dot(angularMomentum, angularMomentum) * offset / (distSqr * distSqr * std::sqrt(distSqr));
+    }
+
+    static bool inline captured(glm::vec3 pos, const RTBlackhole& hole, float power) {
+        return glm::distance(pos, hole.center) < hole.radius * power;
+    }
+
+    static float inline safeStep(glm::vec3 pos, const RTBlackhole& hole, float power, float stepFactor) {
+        return 0.1f * hole.radius * power + stepFactor * (glm::distance(pos, hole.center) - hole.radius * power);
+    }
+};
+
+/**
+ *  Weak-field approximation of a rotating (Kerr) hole: Schwarzschild bending plus a gravitomagnetic term,
+ *  2 dir x (3 (J.r) r - J) / r^3 with J = spin M^2 axis, which drags light along with the rotation.
+ *  Close to the hole this approximation breaks down, so it is only used outside KERR_LUT_RADIUS,
+ *  and the shader maps rays across that sphere with tables baked from exact geodesics instead (see kerr.hpp).
+ */
+struct KerrMetric {
+    static constexpr int        id = METRIC_KERR;
+    static constexpr const char *shaderName = "comp_kerr.spv";
+    static constexpr const char *variantSuffix = "_kerr";
+
+    /**
+     *  Gets the (outer) event horizon radius, M (1 + sqrt(1 - spin^2)).
+     */
+    static float inline horizon(const RTBlackhole& hole, float power) {
+        float spin = glm::clamp(hole.spinAxis_spin.w, 0.f, 0.999f);
+        return 0.5f * hole.radius * power * (1.f + std::sqrt(1.f - spin * spin));
+    }
+
+    static glm::vec3 inline acceleration(glm::vec3 pos, glm::vec3 dir, const RTBlackhole& hole, float power) {
+        float       mass = 0.5f * hole.radius * power,
+                    dist = glm::distance(pos, hole.center);
+        glm::vec3   axis = glm::vec3(hole.spinAxis_spin),
+                    offsetDir = (pos - hole.center) / dist,
+                    angularMomentum = axis * (hole.spinAxis_spin.w * mass * mass / std::max(glm::length(axis), 1e-6f)),
+                    gravitomagnetic = (3.f * glm::dot(angularMomentum, offsetDir) * offsetDir - angularMomentum) / (dist * dist * dist);
+        return SchwarzschildMetric::acceleration(pos, dir, hole, power) + 2.f * glm::cross(dir, gravitomagnetic);
+    }
+
+    static bool inline captured(glm::vec3 pos, const RTBlackhole& hole, float power) {
+        return glm::distance(pos, hole.center) < horizon(hole, power);
+    }
+
+    static float inline safeStep(glm::vec3 pos, const RTBlackhole& hole, float power, float stepFactor) {
+        return 0.01f * hole.radius * power + stepFactor * (glm::distance(pos, hole.center) - horizon(hole, power));
+    }
+};
@@ -0,0 +1,106 @@
+#include "vulkanApplication.h"
+
+#include <cstring>
+#include <filesystem>
+
+
+static const char* PIPELINE_CACHE_PATH = "../resources/cache/pipeline_cache.bin";
+
+/**
+ *  Header written in front of the cached pipeline data.
+ *  The driver's own header is checked as well, but it does not include the driver version.
+ */
+struct PipelineCacheFileHeader {
+    uint32_t    magic = 0x50434348, // "PCCH"
+                version = 1,
+                vendorID = 0,
+                deviceID = 0,
+                driverVersion = 0;
+    uint8_t     pipelineCacheUUID[VK_UUID_SIZE] = {};
+    uint64_t    dataSize = 0;
+};
+
+/**
+ *  Creates the pipeline cache, seeded with the data saved by the previous run if it was made by the same device and driver.
+ */
+void VulkanApplication::createPipelineCache() {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    PipelineCacheFileHeader expected{};
+    expected.vendorID = properties.vendorID;
+    expected.deviceID = properties.deviceID;
+    expected.driverVersion = properties.driverVersion;
+    memcpy(expected.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    // Try the saved data
+    std::vector<char> data;
+    std::ifstream in(PIPELINE_CACHE_PATH, std::ios::binary);
+    if (in.is_open()) {
+        PipelineCacheFileHeader header{};
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+        bool valid = in
+            && header.magic == expected.magic && header.version == expected.version
+            && header.vendorID == expected.vendorID && header.deviceID == expected.deviceID
+            && header.driverVersion == expected.driverVersion
+            && memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) == 0
+            && header.dataSize >= sizeof(VkPipelineCacheHeaderVersionOne);
+        if (valid) {
+            data.resize(header.dataSize);
+            in.read(data.data(), data.size());
+
+            // (Also check the driver's header, in case the file was corrupted)
+            VkPipelineCacheHeaderVersionOne driverHeader;
+            memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+            valid = in
+                && driverHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+                && driverHeader.vendorID == expected.vendorID && driverHeader.deviceID == expected.deviceID
+                && memcmp(driverHeader.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        }
+        if (!valid) {
+            data.clear();
+            printf("Pipeline cache at %s is stale, pipelines will be compiled from scratch\n", PIPELINE_CACHE_PATH);
+        }
+    }
+
+    // Create the cache
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = data.size();
+    cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+    if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+        throw std::runtime_error("ERR::VULKAN::CREATE_PIPELINE_CACHE::CREATION_FAILED");
+}
+
+/**
+ *  Saves the pipeline cache to disk, for the next run.
+ *  Failing to write it is not fatal, the pipelines are simply compiled again next time.
+ */
+void VulkanApplication::savePipelineCache() {
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) return;
+
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS) return;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    PipelineCacheFileHeader header{};
+    header.vendorID = properties.vendorID;
+    header.deviceID = properties.deviceID;
+    header.driverVersion = properties.driverVersion;
+    memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.dataSize = dataSize;
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(PIPELINE_CACHE_PATH).parent_path(), error);
+    std::ofstream out(PIPELINE_CACHE_PATH, std::ios::binary | std::ios::trunc);
+    if (out.is_open()) {
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(data.data(), dataSize);
+    }
+    if (!out.is_open() || !out) printf("Could not save pipeline cache at %s\n", PIPELINE_CACHE_PATH);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "glsl_cpp_common.h"
+#include "volume.hpp"
+
+#include <vector>
+#include <cstdint>
+
+
+/**
+ *  Bakes a turbulent, lens-like refractive-index field into a volume texture.
+ *  The field spans [-1, 1] on every axis and fades out towards the unit sphere, so that n = 1 at its border.
+ *  Gradients are precomputed with central differences, so the shader only needs a single filtered fetch per step.
+ *
+ *  @param falloff Width of the gaussian core, relative to the field's half-size.
+ *  @param turbulence How much of the field is made up of noise, [0, 1].
+ *  @param noiseScale Frequency of the noise.
+ *
+ *  @return The RGBA16F texels, rgb: gradient of n (per half-size), a: n - 1 in [0, 1].
+ */
+std::vector<uint64_t> inline bakeRefractionTexture(
+    float   falloff = 0.45f,
+    float   turbulence = 0.35f,
+    float   noiseScale = 4.f
+) {
+    const int size = RT_REFRACTION_TEXTURE_SIZE;
+
+    // Sample the index field
+    std::vector<float> field(size * size * size);
+    for (int z = 0; z < size; z++)
+    for (int y = 0; y < size; y++)
+    for (int x = 0; x < size; x++) {
+        glm::vec3   p = (glm::vec3(x, y, z) + 0.5f) / float(size) * 2.f - 1.f;
+        float       r = glm::length(p),
+                    core = std::exp(-(r * r) / (falloff * falloff)),
+                    noise = valueNoise(p * noiseScale);
+        field[x + size * (y + size * z)] = core * (1.f - turbulence + turbulence * noise) * (1.f - glm::smoothstep(0.7f, 1.f, r));
+    }
+
+    // Differentiate and pack
+    // (Borders are clamped, matching the sampler)
+    auto at = [&](int x, int y, int z) {
+        x = glm::clamp(x, 0, size - 1); y = glm::clamp(y, 0, size - 1); z = glm::clamp(z, 0, size - 1);
+        return field[x + size * (y + size * z)];
+    };
+    const float invTexelSpan = float(size) / 4.f; // (1 / (2 texels), in [-1, 1] units)
+
+    std::vector<uint64_t> texels(size * size * size);
+    for (int z = 0; z < size; z++)
+    for (int y = 0; y < size; y++)
+    for (int x = 0; x < size; x++) {
+        glm::vec3 gradient = glm::vec3(
+            at(x + 1, y, z) - at(x - 1, y, z),
+            at(x, y + 1, z) - at(x, y - 1, z),
+            at(x, y, z + 1) - at(x, y, z - 1)
+        ) * invTexelSpan;
+        texels[x + size * (y + size * z)] = glm::packHalf4x16(glm::vec4(gradient, at(x, y, z)));
+    }
+
+    return texels;
+}
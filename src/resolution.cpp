@@ -0,0 +1,104 @@
+#include "vulkanApplication.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+/**
+ *  Creates the timestamp queries which time every frame's compute work, two per frame in flight.
+ *  Devices whose compute queue can't write timestamps get none, and keep the full resolution.
+ */
+void VulkanApplication::createTimestampQueries() {
+    timestampScales.assign(framesInFlight, 0.f);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    if (queueFamilies[computeFamily].timestampValidBits == 0 || properties.limits.timestampPeriod == 0) {
+        printf("Compute queue can't write timestamps, dynamic resolution is disabled\n");
+        return;
+    }
+    timestampPeriod = properties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = 2 * framesInFlight;
+
+    if (vkCreateQueryPool(device, &poolInfo, nullptr, &timestampPool) != VK_SUCCESS)
+        throw std::runtime_error("ERR::VULKAN::CREATE_TIMESTAMP_QUERIES::CREATION_FAILED");
+}
+
+/**
+ *  Records a timestamp at the start or end of this frame's compute work.
+ *
+ *  @param commandBuffer The compute command buffer.
+ *  @param end Whether the work ends here, rather than starts.
+ */
+void VulkanApplication::recordFrameTimestamp(VkCommandBuffer commandBuffer, bool end) {
+    if (timestampPool == VK_NULL_HANDLE) return;
+
+    uint32_t query = 2 * currentFrame;
+    if (!end) {
+        vkCmdResetQueryPool(commandBuffer, timestampPool, query, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, query);
+    } else {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, query + 1);
+    }
+}
+
+/**
+ *  Reads how long the GPU took on the compute work last submitted in this frame's slot.
+ *  Must be called once the slot's last frame has finished (see drawFrame), and before the next is submitted.
+ *  Only frames traced while the view moved are timed, as still frames trace more rays per pixel on purpose.
+ */
+void VulkanApplication::readFrameTimestamps() {
+    // (Swapped for the scale of the frame about to be submitted in this slot)
+    float scale = timestampScales[currentFrame];
+    timestampScales[currentFrame] = frame.accumulatedFrames == 0 ? (float)traceExtent.width / fullTraceExtent.width : 0.f;
+    if (timestampPool == VK_NULL_HANDLE || scale <= 0.f) return;
+
+    uint64_t timestamps[2];
+    VkResult res = vkGetQueryPoolResults(device, timestampPool, 2 * currentFrame, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (res != VK_SUCCESS) return;
+
+    // (Smoothed as the time a full resolution frame would take, so frames traced at other scales can be mixed in)
+    gpuFrameTime = (float)(timestamps[1] - timestamps[0]) * timestampPeriod * 1e-6f;
+    float fullTime = gpuFrameTime / (scale * scale);
+    gpuFullFrameTime = gpuFullFrameTime > 0.f ? glm::mix(gpuFullFrameTime, fullTime, 0.25f) : fullTime;
+}
+
+/**
+ *  Picks the resolution to trace the next frame at.
+ *  While the view moves, the resolution is scaled to keep the GPU frame time near DYNAMIC_RESOLUTION_TARGET_MS,
+ *  assuming the time is proportional to the number of pixels. Once the view is still, the full resolution is restored.
+ *
+ *  @param interactive Whether the view moves.
+ *
+ *  @return Whether the trace extent changed, which restarts the accumulation.
+ */
+bool VulkanApplication::updateTraceExtent(bool interactive) {
+    VkExtent2D extent = fullTraceExtent;
+
+    if (DYNAMIC_RESOLUTION && timestampPool != VK_NULL_HANDLE && interactive) {
+        if (gpuFullFrameTime > 0.f) {
+            // Step toward the scale which meets the target, ignoring small errors so the resolution doesn't flicker
+            float ideal = std::sqrt(DYNAMIC_RESOLUTION_TARGET_MS / gpuFullFrameTime);
+            if (std::abs(ideal / renderScale - 1.f) > 0.05f)
+                renderScale = std::clamp(std::clamp(ideal, renderScale * 0.85f, renderScale * 1.1f), DYNAMIC_RESOLUTION_MIN_SCALE, 1.f);
+        }
+
+        // (Rounded to 8 pixels, so the history's resolution changes in steps rather than every frame)
+        auto scaled = [&](uint32_t size) { return std::clamp(((uint32_t)std::lround(size * renderScale / 8.f)) * 8, 8u, size); };
+        extent = VkExtent2D{ scaled(fullTraceExtent.width), scaled(fullTraceExtent.height) };
+    }
+
+    if (extent.width == traceExtent.width && extent.height == traceExtent.height) return false;
+    traceExtent = extent;
+    return true;
+}
@@ -0,0 +1,90 @@
+#include "VulkanApplicationSettings.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstdio>
+
+
+/**
+ *  Applies one runtime setting.
+ *
+ *  @param key The setting's name, as in the config file and the command line (without the dashes).
+ *  @param value The setting's value.
+ */
+static void applyRuntimeSetting(const std::string& key, const std::string& value) {
+    unsigned long number;
+    try {
+        number = std::stoul(value);
+    } catch (const std::exception&) {
+        throw std::runtime_error("ERR::SETTINGS::APPLY_RUNTIME_SETTING::INVALID_VALUE");
+    }
+
+    if (key == "frames-in-flight") {
+        if (number < 1 || number > MAX_FRAMES_IN_FLIGHT)
+            throw std::runtime_error("ERR::SETTINGS::APPLY_RUNTIME_SETTING::FRAMES_IN_FLIGHT_OUT_OF_RANGE");
+        framesInFlight = (uint32_t)number;
+    } else if (key == "swapchain-images") {
+        swapchainImageCount = (uint32_t)number;
+    } else {
+        throw std::runtime_error("ERR::SETTINGS::APPLY_RUNTIME_SETTING::UNKNOWN_KEY");
+    }
+}
+
+/**
+ *  Reads the runtime settings, first from the config file, then from the command line, which overrides it.
+ *  The config file holds one "key = value" per line (# starts a comment), and is optional unless given with --config.
+ *  The command line takes "--key value", and "--config path" to read another config file than RUNTIME_CONFIG_PATH.
+ *
+ *  Keys:
+ *      frames-in-flight    Frames the CPU may record ahead of the GPU, [1, MAX_FRAMES_IN_FLIGHT].
+ *      swapchain-images    Images to ask the swapchain for, 0 for one more than the surface's minimum.
+ *
+ *  @param argc The number of command line arguments.
+ *  @param argv The command line arguments, starting with the program.
+ */
+void loadRuntimeSettings(int argc, char** argv) {
+    // Gather the command line's pairs
+    std::string configPath = RUNTIME_CONFIG_PATH;
+    bool explicitConfig = false;
+    std::vector<std::pair<std::string, std::string>> arguments;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument.rfind("--", 0) != 0 || i + 1 >= argc)
+            throw std::runtime_error("ERR::SETTINGS::LOAD_RUNTIME_SETTINGS::INVALID_ARGUMENT");
+
+        std::string key = argument.substr(2), value = argv[++i];
+        if (key == "config") {
+            configPath = value;
+            explicitConfig = true;
+        }
+        else arguments.emplace_back(key, value);
+    }
+
+    // Read the config file, if there is one
+    std::ifstream file(configPath);
+    if (!file.is_open() && explicitConfig)
+        throw std::runtime_error("ERR::SETTINGS::LOAD_RUNTIME_SETTINGS::CONFIG_NOT_FOUND");
+
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        size_t separator = line.find('=');
+        if (separator == std::string::npos) continue;
+
+        std::string key, value;
+        std::istringstream(line.substr(0, separator)) >> key;
+        std::istringstream(line.substr(separator + 1)) >> value;
+        if (!key.empty()) applyRuntimeSetting(key, value);
+    }
+
+    // Then the command line
+    for (const auto& [key, value] : arguments)
+        applyRuntimeSetting(key, value);
+
+    printf("Frames in flight: %u, swapchain images: ", framesInFlight);
+    if (swapchainImageCount > 0) printf("%u\n", swapchainImageCount);
+    else printf("surface minimum + 1\n");
+}
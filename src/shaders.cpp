@@ -0,0 +1,50 @@
+#include "shaders.hpp"
+
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+
+#ifdef EMBED_SHADERS
+#include "embedded_shaders.h"
+#endif
+
+
+/**
+ *  Reads a compiled shader from disk.
+ *
+ *  @param path The path of the shader.
+ *  @param code Outputs the SPIR-V code.
+ *
+ *  @return Whether the shader could be read.
+ */
+static bool readShaderFile(const std::string& path, std::vector<char>& code) {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) return false;
+
+    code.resize((size_t)file.tellg());
+    file.seekg(0);
+    file.read(code.data(), code.size());
+    return (bool)file;
+}
+
+std::vector<char> loadShader(const std::string& name) {
+    std::vector<char> code;
+
+#ifdef SHADER_HOT_RELOAD
+    if (readShaderFile(std::string(SHADER_BINARY_DIR) + "/" + name, code)) return code;
+#endif
+
+#ifdef EMBED_SHADERS
+    for (const EmbeddedShader& shader : EMBEDDED_SHADERS) {
+        if (name != shader.name) continue;
+        code.resize(shader.size);
+        memcpy(code.data(), shader.code, shader.size);
+        return code;
+    }
+    throw std::runtime_error("ERR::LOAD_SHADER::NOT_EMBEDDED");
+#else
+    if (!readShaderFile("../resources/shaders/" + name, code))
+        throw std::runtime_error("ERR::LOAD_SHADER::FAILURE_OPENING_FILE");
+    return code;
+#endif
+}
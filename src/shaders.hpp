@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+
+/**
+ *  Loads a compiled shader by name, i.e. "comp.spv".
+ *  Builds with EMBED_SHADERS use the SPIR-V embedded at build time, so no file is read.
+ *  With SHADER_HOT_RELOAD, freshly compiled shaders in the build directory take precedence,
+ *  and builds without embedded shaders read them from resources/shaders (see compile.bat).
+ *
+ *  @param name The name of the compiled shader.
+ *
+ *  @return The SPIR-V code.
+ */
+std::vector<char> loadShader(const std::string& name);
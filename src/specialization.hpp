@@ -0,0 +1,83 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "VulkanApplicationSettings.h"
+#include "glsl_cpp_common.h"
+
+#include <cstdint>
+#include <cstddef>
+
+
+/**
+ *  Scene features which select a trace kernel variant.
+ *  Variants without a feature have its loops and branches compiled out.
+ */
+enum SceneFeatures : uint32_t {
+    SCENE_HAS_SPHERES   = 1 << 0,
+    SCENE_HAS_TORI      = 1 << 1,
+    SCENE_HAS_HOLES     = 1 << 2
+};
+
+/**
+ *  Gets the features of a scene from its parameters.
+ *
+ *  @param params The scene's parameters.
+ *
+ *  @return The features, see SceneFeatures.
+ */
+uint32_t inline sceneFeatures(const RTParams& params) {
+    return (params.spheresCount > 0 ? SCENE_HAS_SPHERES : 0)
+        | (params.torusCount > 0 ? SCENE_HAS_TORI : 0)
+        | (params.blackholesCount > 0 ? SCENE_HAS_HOLES : 0);
+}
+
+/**
+ *  The specialization constants of the trace kernels, see SPEC_* in glsl_cpp_common.h.
+ *  Points to itself, so it must stay in place (and alive) until the pipeline is created.
+ */
+struct TraceSpecialization {
+    struct Data {
+        int32_t     raySubdivisions;
+        VkBool32    cullFace;
+        float       rayStepRandomness;
+        VkBool32    hasSpheres,
+                    hasTori,
+                    hasHoles;
+        uint32_t    groupSize;
+    } data;
+    VkSpecializationMapEntry    entries[7];
+    VkSpecializationInfo        info;
+
+    /**
+     *  @param features The scene features of the variant, see SceneFeatures.
+     */
+    TraceSpecialization(uint32_t features) {
+        data = Data{
+            TRACE_RAY_SUBDIVISIONS,
+            TRACE_CULL_FACE ? VK_TRUE : VK_FALSE,
+            TRACE_RAY_STEP_RANDOMNESS,
+            (features & SCENE_HAS_SPHERES) ? VK_TRUE : VK_FALSE,
+            (features & SCENE_HAS_TORI) ? VK_TRUE : VK_FALSE,
+            (features & SCENE_HAS_HOLES) ? VK_TRUE : VK_FALSE,
+            TRACE_GROUP_SIZE
+        };
+
+        entries[0] = { SPEC_RAY_SUBDIVISIONS,    offsetof(Data, raySubdivisions),   sizeof(int32_t) };
+        entries[1] = { SPEC_CULL_FACE,           offsetof(Data, cullFace),          sizeof(VkBool32) };
+        entries[2] = { SPEC_RAY_STEP_RANDOMNESS, offsetof(Data, rayStepRandomness), sizeof(float) };
+        entries[3] = { SPEC_HAS_SPHERES,         offsetof(Data, hasSpheres),        sizeof(VkBool32) };
+        entries[4] = { SPEC_HAS_TORI,            offsetof(Data, hasTori),           sizeof(VkBool32) };
+        entries[5] = { SPEC_HAS_HOLES,           offsetof(Data, hasHoles),          sizeof(VkBool32) };
+        entries[6] = { SPEC_GROUP_SIZE,          offsetof(Data, groupSize),         sizeof(uint32_t) };
+
+        info.mapEntryCount = 7;
+        info.pMapEntries = entries;
+        info.dataSize = sizeof(Data);
+        info.pData = &data;
+    }
+
+    TraceSpecialization(const TraceSpecialization&) = delete;
+    TraceSpecialization& operator=(const TraceSpecialization&) = delete;
+};
@@ -42,11 +42,15 @@ void VulkanApplication::createSwapChain() {
 
     // Set optimal surface format/present mode/extent
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
+    directPresent = DIRECT_PRESENT && chooseDirectPresentFormat(swapChainSupport, surfaceFormat);
     VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
     VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
     // Ask for an additional image to avoid having to wait for driver's internal ops
+    // (Unless a count was set at startup, which is still kept within what the surface allows)
     uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+    if (swapchainImageCount > 0)
+        imageCount = std::max(swapchainImageCount, swapChainSupport.capabilities.minImageCount);
     if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount)
         imageCount = swapChainSupport.capabilities.maxImageCount;
 
@@ -60,6 +64,7 @@ void VulkanApplication::createSwapChain() {
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1; // 1 unless making i.e. a stereoscopic 3D app
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; // If post-processing, VK_IMAGE_USAGE_TRANSFER_DST_BIT
+    if (directPresent) createInfo.imageUsage |= VK_IMAGE_USAGE_STORAGE_BIT; // (Written by the present kernel, see directPresent.cpp)
 
     // Set vulkan sharing mode based on graphics- and presentation family
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
@@ -125,6 +130,10 @@ void VulkanApplication::recreateSwapChain() {
     createSwapChain();
     createImageViews();
     createFramebuffers();
+    createPresentDescriptorSets();
+
+    // Record the graphics command buffers again, for the new framebuffers
+    createGraphicsCommandBuffers();
 }
 
 /**
@@ -134,6 +143,9 @@ void VulkanApplication::cleanupSwapChain() {
     for (auto framebuffer : swapChainFramebuffers) vkDestroyFramebuffer(device, framebuffer, nullptr);
     for (auto imageView : swapChainImageViews) vkDestroyImageView(device, imageView, nullptr);
     vkDestroySwapchainKHR(device, swapChain, nullptr);
+
+    if (presentDescriptorPool != VK_NULL_HANDLE) vkDestroyDescriptorPool(device, presentDescriptorPool, nullptr);
+    presentDescriptorPool = VK_NULL_HANDLE;
 }
 
 /**
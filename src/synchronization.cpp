@@ -2,34 +2,37 @@
 
 /**
  *  Creates synchronization objects such as fences and semaphores.
+ *  Frames are tracked by two timeline semaphores, one for each queue, which count the frames they have finished.
  */
 void VulkanApplication::createSyncObjects() {
     // Make space in vectors
-    imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-    computeInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-    computeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    imageAvailableSemaphores.resize(framesInFlight);
+    renderFinishedSemaphores.resize(framesInFlight);
 
-    // Create semaphore and fence info structs
+    // Create semaphore info structs
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // Start in SIGNALED mode
+    VkSemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0; // Start with no frames done
 
-    // Create semaphores and fences
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    VkSemaphoreCreateInfo timelineSemaphoreInfo{};
+    timelineSemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    timelineSemaphoreInfo.pNext = &timelineInfo;
+
+    // Create semaphores
+    // (The swapchain only takes binary semaphores)
+    for (size_t i = 0; i < framesInFlight; i++) {
         if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS) {
             throw std::runtime_error("ERR::VULKAN::CREATE_SYNC_OBJECTS::CREATION_FAILED_GRAPHICS");
         }
+    }
 
-        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &computeFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(device, &fenceInfo, nullptr, &computeInFlightFences[i]) != VK_SUCCESS) {
-            throw std::runtime_error("ERR::VULKAN::CREATE_SYNC_OBJECTS::CREATION_FAILED_COMPUTE");
-        }
+    if (vkCreateSemaphore(device, &timelineSemaphoreInfo, nullptr, &computeTimeline) != VK_SUCCESS ||
+        vkCreateSemaphore(device, &timelineSemaphoreInfo, nullptr, &graphicsTimeline) != VK_SUCCESS) {
+        throw std::runtime_error("ERR::VULKAN::CREATE_SYNC_OBJECTS::CREATION_FAILED_TIMELINE");
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "glsl_cpp_common.h"
+#include "metric.hpp"
+
+
+/**
+ *  The outcome of tracing a single ray.
+ */
+struct TraceResult {
+    glm::vec3   position,   // Where the ray stopped
+                direction;  // The direction of the ray when it stopped
+    bool        captured;   // Whether the ray fell into the black hole (rather than escaping)
+    int         steps;
+};
+
+/**
+ *  CPU reference tracer for light around a single black hole.
+ *  Integrates the same midpoint scheme as the compute shader's curved segments,
+ *  with the metric's acceleration, horizon test and step size inlined at compile time.
+ *
+ *  @tparam Metric A metric policy, see metric.hpp.
+ */
+template<typename Metric>
+class Tracer {
+public:
+    RTBlackhole hole;
+    float       power,
+                stepFactor,
+                escapeRadius;
+    int         maxSteps;
+
+    Tracer(
+        RTBlackhole hole,
+        float       power = 1.f,
+        float       stepFactor = 0.25f,
+        float       escapeRadius = 100.f,
+        int         maxSteps = 1024
+    ) : hole(hole), power(power), stepFactor(stepFactor), escapeRadius(escapeRadius), maxSteps(maxSteps) {}
+
+    /**
+     *  Traces a ray until it is captured, escapes beyond escapeRadius or runs out of steps.
+     *
+     *  @param origin The origin of the ray.
+     *  @param dir The direction of the ray.
+     *
+     *  @return The result.
+     */
+    TraceResult trace(glm::vec3 origin, glm::vec3 dir) const {
+        TraceResult result { origin, glm::normalize(dir), false, 0 };
+
+        for (; result.steps < maxSteps; result.steps++) {
+            glm::vec3 &pos = result.position, &d = result.direction;
+            if (Metric::captured(pos, hole, power)) { result.captured = true; break; }
+
+            // (Only stop once the ray is moving away, so rays starting far away are still traced)
+            glm::vec3 offset = pos - hole.center;
+            if (glm::dot(offset, offset) > escapeRadius * escapeRadius && glm::dot(offset, d) > 0.f) break;
+
+            // Midpoint step
+            float       stepDist = Metric::safeStep(pos, hole, power, stepFactor),
+                        halfStep = 0.5f * stepDist;
+            glm::vec3   accel = Metric::acceleration(pos, d, hole, power),
+                        midPos = pos + d * halfStep + 0.5f * accel * halfStep * halfStep,
+                        midDir = glm::normalize(d + accel * halfStep);
+            accel = Metric::acceleration(midPos, midDir, hole, power);
+            accel -= glm::dot(accel, d) * d;
+
+            pos += d * stepDist + 0.5f * accel * stepDist * stepDist;
+            d = glm::normalize(d + accel * stepDist);
+        }
+
+        return result;
+    }
+};
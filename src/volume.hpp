@@ -0,0 +1,127 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "glsl_cpp_common.h"
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+
+/**
+ *  A baked volume texture and its occupancy grid, ready to be uploaded.
+ */
+struct VolumeData {
+    std::vector<uint32_t> texels;    // RGBA8 texels, rgb: emission color, a: density
+    std::vector<uint32_t> occupancy; // One bit per occupancy grid cell, set if any texel in (or next to) the cell has density
+};
+
+/**
+ *  Hashed value noise with values in [0, 1].
+ *
+ *  @param p The position to sample.
+ *
+ *  @return The noise value.
+ */
+float inline valueNoise(glm::vec3 p) {
+    auto hash = [](glm::vec3 c) {
+        return glm::fract(std::sin(glm::dot(c, glm::vec3(127.1f, 311.7f, 74.7f))) * 43758.5453f);
+    };
+
+    glm::vec3   i = glm::floor(p),
+                f = glm::fract(p);
+    f = f * f * (3.f - 2.f * f);
+
+    return glm::mix(
+        glm::mix(glm::mix(hash(i),                      hash(i + glm::vec3(1, 0, 0)), f.x),
+                 glm::mix(hash(i + glm::vec3(0, 1, 0)), hash(i + glm::vec3(1, 1, 0)), f.x), f.y),
+        glm::mix(glm::mix(hash(i + glm::vec3(0, 0, 1)), hash(i + glm::vec3(1, 0, 1)), f.x),
+                 glm::mix(hash(i + glm::vec3(0, 1, 1)), hash(i + glm::vec3(1, 1, 1)), f.x), f.y),
+        f.z
+    );
+}
+
+/**
+ *  Builds the occupancy grid for a volume texture.
+ *  Cells are dilated by one texel so that filtered lookups near cell borders are never skipped.
+ *
+ *  @param texels The RGBA8 texels of a RT_VOLUME_TEXTURE_SIZE^3 volume.
+ *
+ *  @return The occupancy bits, packed 32 per word.
+ */
+std::vector<uint32_t> inline buildOccupancyGrid(const std::vector<uint32_t>& texels) {
+    const int   size = RT_VOLUME_TEXTURE_SIZE,
+                grid = RT_VOLUME_GRID_SIZE,
+                cellSize = size / grid;
+
+    std::vector<uint32_t> occupancy((grid * grid * grid + 31) / 32, 0u);
+    for (int cz = 0; cz < grid; cz++)
+    for (int cy = 0; cy < grid; cy++)
+    for (int cx = 0; cx < grid; cx++) {
+        bool occupied = false;
+        for (int z = std::max(cz * cellSize - 1, 0); z <= std::min((cz + 1) * cellSize, size - 1) && !occupied; z++)
+        for (int y = std::max(cy * cellSize - 1, 0); y <= std::min((cy + 1) * cellSize, size - 1) && !occupied; y++)
+        for (int x = std::max(cx * cellSize - 1, 0); x <= std::min((cx + 1) * cellSize, size - 1) && !occupied; x++)
+            occupied = (texels[x + size * (y + size * z)] >> 24) > 0;
+
+        uint32_t bit = cx + grid * (cy + grid * cz);
+        if (occupied) occupancy[bit / 32] |= 1u << (bit % 32);
+    }
+
+    return occupancy;
+}
+
+/**
+ *  Bakes a thick, turbulent accretion disk with polar jets into a volume texture.
+ *  The volume spans [-1, 1] on every axis, with the disk in the xz-plane and the jets along y.
+ *
+ *  @param innerRadius Inner radius of the disk, relative to the volume's half-size.
+ *  @param diskHeight Scale height of the disk, which grows with the radius.
+ *  @param jetWidth Width of the jets at their base.
+ *
+ *  @return The baked volume.
+ */
+VolumeData inline bakeAccretionVolume(
+    float   innerRadius = 0.25f,
+    float   diskHeight = 0.08f,
+    float   jetWidth = 0.04f
+) {
+    const int size = RT_VOLUME_TEXTURE_SIZE;
+
+    VolumeData volume{};
+    volume.texels.resize(size * size * size);
+    for (int z = 0; z < size; z++)
+    for (int y = 0; y < size; y++)
+    for (int x = 0; x < size; x++) {
+        glm::vec3   p = (glm::vec3(x, y, z) + 0.5f) / float(size) * 2.f - 1.f;
+        float       r = glm::length(glm::vec2(p.x, p.z)),
+                    angle = std::atan2(p.z, p.x);
+
+        // Disk, with spiralling turbulence and a hotter inner edge
+        float   radial = glm::smoothstep(innerRadius, innerRadius * 1.3f, r) * (1.f - glm::smoothstep(0.7f, 1.f, r)),
+                height = diskHeight * (0.3f + r),
+                vertical = std::exp(-(p.y * p.y) / (height * height)),
+                turbulence = valueNoise(glm::vec3(r * 8.f, angle * 3.f + r * 6.f, p.y * 8.f)),
+                disk = radial * vertical * (0.4f + 0.6f * turbulence);
+        glm::vec3 diskColor = glm::mix(glm::vec3(1.f, 0.35f, 0.1f), glm::vec3(1.f, 0.9f, 0.7f), glm::smoothstep(0.8f, innerRadius, r));
+
+        // Jets, widening with distance from the disk
+        float   jetRadius = jetWidth * (0.3f + std::abs(p.y)),
+                jet = std::exp(-(r * r) / (jetRadius * jetRadius))
+                    * glm::smoothstep(innerRadius * 0.5f, innerRadius, std::abs(p.y))
+                    * (1.f - glm::smoothstep(0.6f, 1.f, std::abs(p.y)));
+        glm::vec3 jetColor = glm::vec3(0.4f, 0.6f, 1.f);
+
+        // Combine and pack
+        float       density = glm::clamp(disk + jet, 0.f, 1.f);
+        glm::vec3   color = density > 0.f ? (diskColor * disk + jetColor * jet) / (disk + jet) : glm::vec3(0.f);
+        glm::uvec4  texel = glm::uvec4(glm::clamp(glm::vec4(color, density), 0.f, 1.f) * 255.f + 0.5f);
+        volume.texels[x + size * (y + size * z)] = texel.r | (texel.g << 8) | (texel.b << 16) | (texel.a << 24);
+    }
+
+    volume.occupancy = buildOccupancyGrid(volume.texels);
+    return volume;
+}
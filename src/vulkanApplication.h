@@ -14,10 +14,19 @@
 #include "camera.hpp"
 #include "glsl_cpp_common.h"
 #include "buffer.hpp"
+#include "volume.hpp"
+#include "refraction.hpp"
+#include "kerr.hpp"
+#include "specialization.hpp"
+#include "budget.hpp"
+#include "shaders.hpp"
 
 #include <vector>
 #include <optional>
+#include <unordered_map>
+#include <filesystem>
 #include <fstream>
+#include <algorithm>
 
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
@@ -80,12 +89,30 @@ static std::vector<char> readFile(const std::string& filename) {
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsAndComputeFamily;
     std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> asyncComputeFamily; // Compute without graphics, if the device has such a family (optional)
 
     bool isComplete() {
         return graphicsAndComputeFamily.has_value() && presentFamily.has_value();
     }
 };
 
+/**
+ *  Struct for what a pre-recorded compute command buffer depends on, besides the state in mapped memory.
+ *  The command buffer is recorded again whenever it changes (see drawFrame).
+ */
+struct ComputeCommandsKey {
+    uint32_t version;               // See commandsVersion
+    uint32_t traceWidth, traceHeight;
+    uint32_t denoiseIterations;
+    uint32_t waves;                 // Wavefront waves per frame, 0 in the other trace modes
+    uint32_t wavefrontRounds;       // Bend/intersect/shade rounds per wave, 0 in the other trace modes
+
+    bool operator==(const ComputeCommandsKey& other) const {
+        return version == other.version && traceWidth == other.traceWidth && traceHeight == other.traceHeight
+            && denoiseIterations == other.denoiseIterations && waves == other.waves && wavefrontRounds == other.wavefrontRounds;
+    }
+};
+
 /**
  *  Struct for storing details about swapchain support.
  */
@@ -121,8 +148,13 @@ public:
         createCommandPool(
             physicalDevice,
             device,
-            findQueueFamilies(physicalDevice).graphicsAndComputeFamily.value(),
+            graphicsFamily,
             commandPool );
+        createCommandPool(
+            physicalDevice,
+            device,
+            computeFamily,
+            computeCommandPool );
 
         // Set up RTSpheres
         std::vector<RTSphere> spheres {
@@ -159,160 +191,216 @@ public:
         };
 
         // Set up RTBlackholes
+        // (Spin is only used by the Kerr variant)
         std::vector<RTBlackhole> blackholes {
             RTBlackhole {
                 0.5f,
                 glm::vec3(0,1,6),
+                glm::vec4(0,1,0,0.9f)
             }
         };
 
-        std::vector<RTTorus> torus {
-            RTTorus {
-                glm::vec4(0.f, 1.f, 6.f, 3.5f / 1.25f),
-                glm::vec4(3.14f / 2.f, 0.f, 0.f, 0.05f / 1.25f),
-                    RTMaterial{
-                        glm::vec4(1.f,0.7f,0.3f,0.1f),
-                        glm::vec4(1.f,0.5f,0.1f,0.8f),
-                        glm::vec4(1.f,0.7f,0.3f,0.0f),
-                        0.5f
-                }
-            },
-            RTTorus {
-                glm::vec4(0.f, 1.f, 6.f, 3.4f / 1.25f),
-                glm::vec4(3.14f / 2.f, 0.f, 0.f, 0.1f / 1.25f),
-                    RTMaterial{
-                        glm::vec4(1.f,0.4f,0.3f,0.1f),
-                        glm::vec4(1.f,0.5f,0.1f,0.8f),
-                        glm::vec4(1.f,0.7f,0.3f,0.0f),
-                        0.5f
-                }
-            },
-            RTTorus {
-                glm::vec4(0.f, 1.f, 6.f, 3.1f / 1.25f),
-                glm::vec4(3.14f / 2.f, 0.f, 0.f, 0.1f / 1.25f),
-                    RTMaterial{
-                        glm::vec4(1.f,0.4f,0.3f,0.1f),
-                        glm::vec4(1.0f,0.7f,1.0f,0.8f),
-                        glm::vec4(1.f,0.7f,0.3f,0.0f),
-                        0.5f
-                }
-            },
-            RTTorus {
-                glm::vec4(0.f, 1.f, 6.f, 2.7f / 1.25f),
-                glm::vec4(3.14f / 2.f, 0.f, 0.f, 0.15f / 1.25f),
-                    RTMaterial{
-                        glm::vec4(1.f,0.4f,0.3f,0.1f),
-                        glm::vec4(1.0f,0.7f,1.0f,2.f),
-                        glm::vec4(1.f,0.7f,0.3f,0.0f),
-                        0.5f
-                }
-            },
-
+        // Bake (or load) the Kerr transfer tables, if the Kerr variant is used
+        // (Other variants get a single dummy texel, as the bindings are shared)
+        // (Only one table is baked, so every hole must spin alike, where a zero axis counts as no spin)
+        KerrLUT kerrLUT { std::vector<uint64_t>(1, 0), std::vector<uint64_t>(1, 0) };
+        bool useKerrLUT = ActiveMetric::id == METRIC_KERR && !blackholes.empty();
+        if (useKerrLUT) {
+            auto effectiveSpin = [](const RTBlackhole& hole) { return glm::vec3(hole.spinAxis_spin) != glm::vec3(0.f) ? hole.spinAxis_spin.w : 0.f; };
+            for (const auto& hole : blackholes)
+                if (effectiveSpin(hole) != effectiveSpin(blackholes[0]))
+                    throw std::runtime_error("ERR::KERR::RUN::BLACKHOLE_SPINS_DIFFER");
+            kerrLUT = loadKerrLUT(effectiveSpin(blackholes[0]));
+        }
 
-            //RTTorus {
-            //    glm::vec4(0.f, 1.f, 6.f, 2.3f / 1.25f),
-            //    glm::vec4(3.14f / 2.f, 0.f, 0.f, 0.2f / 1.25f),
-            //        RTMaterial{
-            //            glm::vec4(1.f,0.4f,0.3f,0.1f),
-            //            glm::vec4(1.f,0.5f,0.1f,1.f),
-            //            glm::vec4(1.f,0.7f,0.3f,0.0f),
-            //            0.5f
-            //    }
-            //},
-            //RTTorus {
-            //    glm::vec4(0.f, 1.f, 6.f, 2.0f / 1.25f),
-            //    glm::vec4(3.14f / 2.f, 0.f, 0.f, 0.2f / 1.25f),
-            //        RTMaterial{
-            //            glm::vec4(1.f,0.4f,0.3f,0.1f),
-            //            glm::vec4(1.0f,0.7f,1.0f,2.f),
-            //            glm::vec4(1.f,0.7f,0.3f,0.0f),
-            //            0.5f
-            //    }
-            //},
-            //RTTorus {
-            //    glm::vec4(0.f, 1.f, 6.f, 1.8f / 1.25f),
-            //    glm::vec4(3.14f / 2.f, 0.f, 0.f, 0.25f / 1.25f),
-            //        RTMaterial{
-            //            glm::vec4(1.f,0.4f,0.3f,0.1f),
-            //            glm::vec4(1.0f,0.7f,1.0f,2.5f),
-            //            glm::vec4(1.f,0.7f,0.3f,0.0f),
-            //            0.5f
-            //    }
-            //},
-            //RTTorus {
-            //    glm::vec4(0.f, 1.f, 6.f, 0.5),
-            //    glm::vec4(3.14f / 2.f, 0.f, 0.f, 0.05),
-            //        RTMaterial{
-            //            glm::vec4(1.f,0.4f,0.3f,0.1f),
-            //            glm::vec4(1.0f,0.7f,1.0f,10.f),
-            //            glm::vec4(1.f,0.7f,0.3f,0.0f),
-            //            0.5f
-            //    }
-            //},
+        // Set up RTTorus
+        std::vector<RTTorus> torus;
+
+        // Set up RTDisks
+        // (A single thin disk replaces the stacked tori of old, which each cost a quartic solve per step)
+        std::vector<RTDisk> disks {
+            RTDisk {
+                glm::vec4(0.f, 1.f, 6.f, 1.2f),
+                glm::vec4(0.f, 1.f, 0.f, 2.9f),
+                glm::vec4(2.f, 0.8f, 0.f, 0.f),
+                RTMaterial {
+                    glm::vec4(1.f,0.6f,0.3f,0.1f),
+                    glm::vec4(1.f,0.6f,0.25f,4.f),
+                    glm::vec4(1.f,0.7f,0.3f,0.0f),
+                    0.f
+                }
+            }
         };
 
-        // Make a buffer for holding dispatch size
-        struct DispatchIndirectCommand {
-            uint32_t x;
-            uint32_t y;
-            uint32_t z;
-        } dispatchCmd = { WIDTH / 32, HEIGHT / 32, 1 }; // Example workgroup counts
-
-        VkDeviceSize bufferSize = sizeof(DispatchIndirectCommand);
-        dispatchBuffer = createBuffer(
-            physicalDevice, device,
-            bufferSize,
-            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            dispatchBufferMemory
-        );
-
-        // Upload the dispatch command to the buffer
-        void* data;
-        vkMapMemory(device, dispatchBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, &dispatchCmd, sizeof(dispatchCmd));
-        vkUnmapMemory(device, dispatchBufferMemory);
+        // Set up RTVolumes
+        // (All volumes share the same baked disk-and-jets texture, which is only baked if any are used)
+        std::vector<RTVolume> volumes;
+        if (DEMO_VOLUME) volumes.push_back(RTVolume {
+            glm::vec4(-3.5f, -2.5f, 2.5f, 4.f),
+            glm::vec4(3.5f, 4.5f, 9.5f, 1.5f)
+        });
+        bool useVolumeTexture = !volumes.empty();
+        VolumeData accretionVolume = useVolumeTexture ? bakeAccretionVolume() : VolumeData { std::vector<uint32_t>(1, 0), std::vector<uint32_t>(1, 0) };
+
+        // Set up SDF objects
+        // (A station orbiting the hole: a hollowed, rounded hub smoothly joined with a ring by a spoke)
+        std::vector<RTSdfNode> sdfNodes;
+        std::vector<RTSdfObject> sdfObjects;
+        if (DEMO_SDF) {
+            sdfNodes = {
+                RTSdfNode { glm::vec4(-5.f, 2.f, 9.f, 0.f),   glm::vec4(0.5f, 0.5f, 0.5f, 0.1f), RT_SDF_BOX },
+                RTSdfNode { glm::vec4(-5.f, 2.f, 9.f, 0.f),   glm::vec4(0.62f, 0.f, 0.f, 0.f),   RT_SDF_SPHERE },
+                RTSdfNode { glm::vec4(0.f),                    glm::vec4(0.f),                     RT_SDF_SUBTRACT },
+                RTSdfNode { glm::vec4(-5.f, 2.f, 9.f, 0.f),   glm::vec4(1.4f, 0.f, 0.f, 0.12f),  RT_SDF_CAPSULE },
+                RTSdfNode { glm::vec4(0.f),                    glm::vec4(0.15f, 0.f, 0.f, 0.f),   RT_SDF_SMOOTH_UNION },
+                RTSdfNode { glm::vec4(-5.f, 2.f, 9.f, 0.f),   glm::vec4(1.4f, 0.1f, 0.f, 0.f),   RT_SDF_TORUS },
+                RTSdfNode { glm::vec4(0.f),                    glm::vec4(0.1f, 0.f, 0.f, 0.f),    RT_SDF_SMOOTH_UNION },
+            };
+            sdfObjects = {
+                RTSdfObject {
+                    glm::vec4(-5.f, 2.f, 9.f, 1.6f),
+                    0, (uint)sdfNodes.size(),
+                    RTMaterial {
+                        glm::vec4(0.8f,0.8f,0.85f,1.f),
+                        glm::vec4(0.f),
+                        glm::vec4(1.f,1.f,1.f,0.3f),
+                        0.9f
+                    }
+                }
+            };
+        }
+
+        // Set up RTMedia
+        // (Gradient-index media bend light alongside the black hole, textured media share one baked index field, which is only baked if any are used)
+        std::vector<RTMedium> media;
+        if (DEMO_MEDIUM) media.push_back(RTMedium {
+            glm::vec4(4.5f, 1.5f, 8.f, 1.5f),
+            glm::vec4(0.4f, 0.f, 0.f, 0.f),
+            RT_MEDIUM_TEXTURE
+        });
+        bool useRefractionTexture = std::any_of(media.begin(), media.end(), [](const RTMedium& medium) { return medium.type == RT_MEDIUM_TEXTURE; });
+        std::vector<uint64_t> refractionTexels = useRefractionTexture ? bakeRefractionTexture() : std::vector<uint64_t>(1, 0);
+
+        // Set up the tile list
+        // (3 words of indirect dispatch arguments, followed by up to one entry per tile)
+        uint32_t tileCount = ((swapChainExtent.width + RT_TILE_SIZE - 1) / RT_TILE_SIZE) * ((swapChainExtent.height + RT_TILE_SIZE - 1) / RT_TILE_SIZE);
+        std::vector<uint32_t> tileList(3 + tileCount, 0);
+
+        // Set up the wavefront ray buffers
+        // (One ray per pixel, and 4 words of header per queue followed by up to one entry per pixel, only allocated when used)
+        size_t rayCount = TRACE_MODE == TraceMode::Wavefront ? (size_t)swapChainExtent.width * swapChainExtent.height : 1;
+        std::vector<RTRayState> rayStates(rayCount);
+        std::vector<RTRayHit> rayHits(rayCount);
+        std::vector<uint32_t> rayQueues(WAVEFRONT_QUEUE_COUNT * (sizeof(RTQueue) / sizeof(uint32_t) + rayCount), 0);
+        for (uint32_t queue = 0; queue < WAVEFRONT_QUEUE_COUNT; queue++)
+            ((RTQueue*)rayQueues.data())[queue] = RTQueue{ 0, 1, 1, 0, 0 };
 
         // Set up RTParams
         RTParams ubo{};
+        fullTraceExtent = traceExtent = VkExtent2D{ (uint32_t)camera.screenSize.x, (uint32_t)camera.screenSize.y };
         ubo.screenSize = camera.screenSize;
+        ubo.imageHeight = swapChainExtent.height;
         ubo.fov = camera.fov;
         ubo.focusDistance = camera.focusDistance;
         
         ubo.maxBounces = 1;
         ubo.raysPerFrag = 12;
+        ubo.interactiveRaysPerFrag = 2;
         ubo.divergeStrength = 0.025f;
         ubo.blackholePower = 1.f;
+        ubo.previewMode = 0;
+        ubo.previewFallbackRadius = 6.f;
+        ubo.adaptiveThreshold = 0.02f;
+        ubo.adaptiveMinFrames = 4;
+        ubo.persistentBatchSize = 4 * PERSISTENT_GROUP_SIZE;
+        ubo.persistentOrder = PERSISTENT_ORDER_MORTON;
+        ubo.temporalEnabled = 1;
+        ubo.temporalMaxHistory = 16.f;
+        ubo.temporalClampScale = 1.25f;
+        ubo.denoiseIterations = denoiseIterations = 4;
+        ubo.denoiseColorSigma = 4.f;
+        ubo.denoiseNormalPower = 128.f;
+        ubo.denoiseDepthSigma = 0.01f;
+        ubo.budgetEnabled = 1;
+        ubo.foveaCenter = glm::vec2(0.5f);
+        ubo.foveaRadius = 0.2f;
+        ubo.foveaFalloff = 0.4f;
+        ubo.budgetMin = 0.25f;
         
         ubo.spheresCount = spheres.size();
         ubo.blackholesCount = blackholes.size();
         ubo.torusCount = torus.size();
+        ubo.disksCount = disks.size();
+        ubo.volumesCount = volumes.size();
+        ubo.sdfObjectsCount = sdfObjects.size();
+        ubo.mediaCount = media.size();
 
         // Create buffers and layout
-        computeBundle = BufferBuilder(physicalDevice, device, commandPool, computeQueue, &deletionQueue)
+        // (Uploaded on the graphics queue, whose transitions may target any stage, then handed to the compute family below)
+        computeBundle = BufferBuilder(physicalDevice, device, commandPool, graphicsQueue, &deletionQueue)
             .UBO(b_params, VK_SHADER_STAGE_COMPUTE_BIT, std::vector<RTParams>{ubo})
             .SSBO(b_spheres, VK_SHADER_STAGE_COMPUTE_BIT, spheres)
             .SSBO(b_blackholes, VK_SHADER_STAGE_COMPUTE_BIT, blackholes)
-            .genericImage(b_image, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, true, true, nullptr, nullptr, swapChainExtent.width, swapChainExtent.height)
+            .genericImage(b_image, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, true, true, nullptr, nullptr, swapChainExtent.width, swapChainExtent.height, chooseOutputFormat())
+            .genericImage(b_accumulation, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, false, true, nullptr, nullptr, swapChainExtent.width, swapChainExtent.height, VK_FORMAT_R32G32B32A32_SFLOAT, false)
+            .genericImage(b_moments, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, false, true, nullptr, nullptr, swapChainExtent.width, swapChainExtent.height, VK_FORMAT_R32_SFLOAT, false)
+            .genericImage(b_hitBuffer, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, false, true, nullptr, nullptr, swapChainExtent.width, 2 * swapChainExtent.height, VK_FORMAT_R32G32B32A32_SFLOAT, false)
+            .genericImage(b_history, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, false, true, nullptr, nullptr, swapChainExtent.width, 2 * swapChainExtent.height, VK_FORMAT_R32G32B32A32_SFLOAT, false)
+            .genericImage(b_temporalPrior, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, false, true, nullptr, nullptr, swapChainExtent.width, swapChainExtent.height, VK_FORMAT_R32G32B32A32_SFLOAT, false)
+            .genericImage(b_hitNormal, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, false, true, nullptr, nullptr, swapChainExtent.width, swapChainExtent.height, VK_FORMAT_R32G32B32A32_SFLOAT, false)
+            .genericImage(b_denoise, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, false, true, nullptr, nullptr, swapChainExtent.width, 2 * swapChainExtent.height, VK_FORMAT_R32G32B32A32_SFLOAT, false)
+            .UBO(b_reprojection, VK_SHADER_STAGE_COMPUTE_BIT, std::vector<RTReprojection>{ RTReprojection{ camera.rts, camera.screenSize } })
+            .UBO(b_frame, VK_SHADER_STAGE_COMPUTE_BIT, std::vector<RTFrame>{ frame })
+            .genericBuffer(b_tiles, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, false, tileList)
+            .SSBO(b_rayStates, VK_SHADER_STAGE_COMPUTE_BIT, rayStates)
+            .SSBO(b_rayHits, VK_SHADER_STAGE_COMPUTE_BIT, rayHits)
+            .genericBuffer(b_rayQueues, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, false, rayQueues)
+            .genericBuffer(b_wavefrontRounds, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true, std::vector<uint32_t>{ 0 })
+            .SSBO(b_workCounter, VK_SHADER_STAGE_COMPUTE_BIT, std::vector<uint32_t>{ 0 })
+            .SSBO(b_budgetMap, VK_SHADER_STAGE_COMPUTE_BIT, loadBudgetMap(BUDGET_MAP_PATH))
             .sampler(b_skybox, VK_SHADER_STAGE_COMPUTE_BIT, "../resources/textures/texture.jpg")
             .SSBO(b_torus, VK_SHADER_STAGE_COMPUTE_BIT, torus)
+            .SSBO(b_disks, VK_SHADER_STAGE_COMPUTE_BIT, disks)
+            .SSBO(b_volumes, VK_SHADER_STAGE_COMPUTE_BIT, volumes)
+            .volume(b_volumeTexture, VK_SHADER_STAGE_COMPUTE_BIT, VK_FORMAT_R8G8B8A8_UNORM, useVolumeTexture ? RT_VOLUME_TEXTURE_SIZE : 1, useVolumeTexture ? RT_VOLUME_TEXTURE_SIZE : 1, useVolumeTexture ? RT_VOLUME_TEXTURE_SIZE : 1, accretionVolume.texels)
+            .SSBO(b_volumeOccupancy, VK_SHADER_STAGE_COMPUTE_BIT, accretionVolume.occupancy)
+            .SSBO(b_sdfNodes, VK_SHADER_STAGE_COMPUTE_BIT, sdfNodes)
+            .SSBO(b_sdfObjects, VK_SHADER_STAGE_COMPUTE_BIT, sdfObjects)
+            .SSBO(b_media, VK_SHADER_STAGE_COMPUTE_BIT, media)
+            .volume(b_refractionTexture, VK_SHADER_STAGE_COMPUTE_BIT, VK_FORMAT_R16G16B16A16_SFLOAT, useRefractionTexture ? RT_REFRACTION_TEXTURE_SIZE : 1, useRefractionTexture ? RT_REFRACTION_TEXTURE_SIZE : 1, useRefractionTexture ? RT_REFRACTION_TEXTURE_SIZE : 1, refractionTexels)
+            .volume(b_kerrDirection, VK_SHADER_STAGE_COMPUTE_BIT, VK_FORMAT_R16G16B16A16_SFLOAT, useKerrLUT ? KERR_LUT_SIZE_PSI : 1, useKerrLUT ? KERR_LUT_SIZE_B : 1, useKerrLUT ? KERR_LUT_SIZE_THETA : 1, kerrLUT.direction, VK_SAMPLER_ADDRESS_MODE_REPEAT)
+            .volume(b_kerrExit, VK_SHADER_STAGE_COMPUTE_BIT, VK_FORMAT_R16G16B16A16_SFLOAT, useKerrLUT ? KERR_LUT_SIZE_PSI : 1, useKerrLUT ? KERR_LUT_SIZE_B : 1, useKerrLUT ? KERR_LUT_SIZE_THETA : 1, kerrLUT.exit, VK_SAMPLER_ADDRESS_MODE_REPEAT)
             .build();
 
         graphicsBundle = BufferBuilder(physicalDevice, device, commandPool, graphicsQueue, &deletionQueue)
-            .sampler(0, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr, &computeBundle.imageMemories[b_image])
+            .sampler(0, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, nullptr, &computeBundle.imageMemories[b_image])
+            .UBO(1, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, std::vector<RTPresent>{ RTPresent{} })
             .build();
+        transferComputeOwnership();
 
-        computePushConstantReference = &frame;
-        computePushConstantSize = sizeof(RTFrame);
+        traceFeatures = sceneFeatures(ubo);
 
         createComputeCommandBuffers();
         createGraphicsCommandBuffers();
 
+        createPipelineCache();
+        createTimestampQueries();
         createGraphicsPipeline();
+        createPresentPipeline();
         createComputePipeline();
 
         createSyncObjects();
 
+        bool previewKeyWasPressed = false;
+        bool temporalKeyWasPressed = false;
+        bool denoiseKeyWasPressed = false;
+        bool interleaveKeyWasPressed = false;
+        bool budgetKeyWasPressed = false;
+        bool tonemapKeyWasPressed = false;
+        uint32_t interleave = INTERLEAVE;
+        previousLocalToWorld = camera.rts;
+        previousScreenSize = camera.screenSize;
+        uint32_t accumulationVersion = computeBundle.version;
         while (!glfwWindowShouldClose(window)) {
             glfwPollEvents();
             drawFrame();
@@ -334,8 +422,52 @@ public:
                 dtAng.x += lastFrameTime * cameraRotationSpeed;
             }
             if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) {
-                printf("FPS = %i\n", (int)(1.f / lastFrameTime));
+                printf("FPS = %i, GPU %.2f ms at %ux%u\n", (int)(1.f / lastFrameTime), gpuFrameTime, traceExtent.width, traceExtent.height);
+            }
+            bool previewKeyPressed = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+            if (previewKeyPressed && !previewKeyWasPressed) {
+                ubo.previewMode = !ubo.previewMode;
+                computeBundle.updateBuffer(b_params, std::vector<RTParams>{ubo});
+                printf("Preview mode %s\n", ubo.previewMode ? "ON" : "OFF");
+            }
+            previewKeyWasPressed = previewKeyPressed;
+            bool temporalKeyPressed = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+            if (temporalKeyPressed && !temporalKeyWasPressed) {
+                ubo.temporalEnabled = !ubo.temporalEnabled;
+                computeBundle.updateBuffer(b_params, std::vector<RTParams>{ubo});
+                printf("Temporal reprojection %s\n", ubo.temporalEnabled ? "ON" : "OFF");
             }
+            temporalKeyWasPressed = temporalKeyPressed;
+            bool denoiseKeyPressed = glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS;
+            if (denoiseKeyPressed && !denoiseKeyWasPressed) {
+                ubo.denoiseIterations = denoiseIterations = denoiseIterations > 0 ? 0 : 4;
+                computeBundle.updateBuffer(b_params, std::vector<RTParams>{ubo});
+                printf("Denoiser %s\n", denoiseIterations > 0 ? "ON" : "OFF");
+            }
+            denoiseKeyWasPressed = denoiseKeyPressed;
+            bool interleaveKeyPressed = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+            if (interleaveKeyPressed && !interleaveKeyWasPressed) {
+                interleave = interleave >= 4 ? 1 : interleave * 2;
+                printf("Interleaved tracing: 1 of every %u pixels\n", interleave);
+            }
+            interleaveKeyWasPressed = interleaveKeyPressed;
+            bool budgetKeyPressed = glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS;
+            if (budgetKeyPressed && !budgetKeyWasPressed) {
+                ubo.budgetEnabled = !ubo.budgetEnabled;
+                computeBundle.updateBuffer(b_params, std::vector<RTParams>{ubo});
+                printf("Sample budgets %s\n", ubo.budgetEnabled ? "ON" : "OFF");
+            }
+            budgetKeyWasPressed = budgetKeyPressed;
+            if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS) exposure -= lastFrameTime * 2.f;
+            if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS) exposure += lastFrameTime * 2.f;
+            bool tonemapKeyPressed = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+            if (tonemapKeyPressed && !tonemapKeyWasPressed) {
+                tonemap = (tonemap + 1) % TONEMAP_COUNT;
+                const char* tonemapNames[TONEMAP_COUNT] = { "clamp", "Reinhard", "ACES" };
+                printf("Tonemapping: %s\n", tonemapNames[tonemap]);
+            }
+            tonemapKeyWasPressed = tonemapKeyPressed;
+            bool shadersReloaded = pollShaderChanges();
             if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
                 dtPos -= camera.left * lastFrameTime * cameraSpeed;
             }
@@ -366,6 +498,25 @@ public:
             frame.localToWorld = camera.rts;
             frame.frameNumber++;
 
+            // Restart accumulation whenever the view or any parameters change
+            // (Few rays are traced while interacting, the image converges once the view is still)
+            bool viewChanged = glm::length(dtAng) > 0.f || glm::length(dtPos) > 0.f;
+            // (The trace extent goes in the frame state, which every slot has its own copy of, see writeFrameState)
+            bool extentChanged = updateTraceExtent(viewChanged);
+            frame.traceSize = glm::vec2(traceExtent.width, traceExtent.height);
+            // (While the view moves only some pixels are traced, so the accumulation restarts once more when it stops)
+            bool restart = viewChanged || extentChanged || shadersReloaded || computeBundle.version != accumulationVersion;
+            if (restart || frame.interleave > 1) {
+                frame.accumulatedFrames = 0;
+                frame.raysPerFrag = ubo.interactiveRaysPerFrag;
+                accumulationVersion = computeBundle.version;
+                frame.interleave = restart ? interleave : 1;
+                frame.interleavePhase = (frame.interleavePhase + 1) % frame.interleave;
+            } else {
+                frame.accumulatedFrames++;
+                frame.raysPerFrag = ubo.raysPerFrag;
+            }
+
             // Time
             double currentTime = glfwGetTime();
             lastFrameTime = currentTime - lastTime;
@@ -398,6 +549,8 @@ private:
     // Queues
     VkQueue graphicsQueue;
     VkQueue computeQueue;
+    uint32_t graphicsFamily;
+    uint32_t computeFamily; // The async compute family, or the graphics family if there is none (see ASYNC_COMPUTE)
     VkQueue presentQueue;
 
     // Swapchain
@@ -410,32 +563,74 @@ private:
 
     // Global (Graphics + Compute)
     VkCommandPool commandPool;
+    VkCommandPool computeCommandPool;
 
     // Buffers and layout
     BufferBundle computeBundle;
     BufferBundle graphicsBundle;
 
+    // Pipeline cache
+    // (Saved to resources/cache at shutdown, so the trace kernels aren't recompiled by the driver every launch)
+    VkPipelineCache                 pipelineCache = VK_NULL_HANDLE;
+
     // Graphics
     VkRenderPass                    renderPass;
     VkPipelineLayout                graphicsPipelineLayout;
     VkPipeline                      graphicsPipeline;
-    std::vector<VkCommandBuffer>    graphicsCommandBuffers;
+    std::vector<VkCommandBuffer>    graphicsCommandBuffers; // One per frame in flight and swapchain image
+    std::vector<uint32_t>           graphicsCommandsVersions; // Of the commands recorded into each, 0 if none (see commandsVersion)
+
+    // Direct present (see DIRECT_PRESENT)
+    bool                            directPresent = false; // Whether the current swapchain is written by the present kernel
+    VkDescriptorSetLayout           presentSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout                presentPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline                      presentPipeline = VK_NULL_HANDLE;
+    VkDescriptorPool                presentDescriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet>    presentDescriptorSets; // One per swapchain image
 
     // Compute
     VkPipelineLayout                computePipelineLayout;
     VkPipeline                      computePipeline;
     std::vector<VkCommandBuffer>    computeCommandBuffers;
-    void*                           computePushConstantReference = nullptr;
-    uint32_t                        computePushConstantSize = 0;
-    VkBuffer                        dispatchBuffer;
-    VkDeviceMemory                  dispatchBufferMemory;
+    std::vector<ComputeCommandsKey> computeCommandsKeys; // Of the commands recorded into each
+    uint32_t                        commandsVersion = 1; // Bumped when the compute pipelines are recreated, which records every command buffer again
+    VkPipeline                      classifyPipeline;
+    VkPipeline                      temporalPipeline = VK_NULL_HANDLE;
+    VkPipeline                      atrousPipeline = VK_NULL_HANDLE;
+    uint32_t                        denoiseIterations = 0; // Denoiser iterations recorded per frame, as in RTParams
+    glm::mat4                       previousLocalToWorld = glm::mat4(1.f); // Camera of the last recorded frame
+    glm::vec2                       previousScreenSize = glm::vec2(0.f); // Trace resolution of the last recorded frame
+    VkPipeline                      wavefrontPipelines[WAVEFRONT_STAGE_COUNT] = {};
+    uint32_t                        wavefrontRounds = WAVEFRONT_ITERATIONS; // Rounds recorded per wave, see readWavefrontRounds
+    VkPipeline                      persistentPipeline = VK_NULL_HANDLE;
+    std::unordered_map<uint32_t, VkPipeline> traceVariants; // Trace kernels by scene features, computePipeline is one of them
+    uint32_t                        traceFeatures = 0;
+
+    // Shader hot reload (builds configured with SHADER_HOT_RELOAD only)
+    std::filesystem::file_time_type shaderSourceTime{};
+    double                          lastShaderPoll = 0.0;
+    uint32_t                        persistentWorkgroups = 0;
+
+    // Dynamic resolution
+    VkExtent2D                      fullTraceExtent{};  // Size of the compute images
+    VkExtent2D                      traceExtent{};      // Part of the compute images traced this frame, as in RTParams
+    float                           renderScale = 1.f;  // Scale of the trace extent while the view moves
+    VkQueryPool                     timestampPool = VK_NULL_HANDLE;
+    float                           timestampPeriod = 1.f; // Nanoseconds per timestamp tick
+    std::vector<float>              timestampScales;    // Render scale of every slot's timed frame, 0 if not timed
+    float                           gpuFrameTime = 0.f; // Of the last timed frame, in milliseconds
+    float                           gpuFullFrameTime = 0.f; // Smoothed estimate of a full resolution frame, in milliseconds
+
+    // Present
+    float                           exposure = 0.f; // In stops
+    uint32_t                        tonemap = TONEMAP; // See TONEMAP_*
 
     // Synchronization
     std::vector<VkSemaphore>    imageAvailableSemaphores;
     std::vector<VkSemaphore>    renderFinishedSemaphores;
-    std::vector<VkSemaphore>    computeFinishedSemaphores;
-    std::vector<VkFence>        inFlightFences;
-    std::vector<VkFence>        computeInFlightFences;
+    VkSemaphore                 computeTimeline;    // Reaches a frame's number once its compute work is done
+    VkSemaphore                 graphicsTimeline;   // Reaches a frame's number once it has been drawn
+    uint64_t                    frameNumber = 0;    // Of the last submitted frame, frames count from 1
 
     // Drawing
     uint32_t currentFrame = 0;
@@ -454,6 +649,11 @@ private:
     RTFrame frame = RTFrame{
         camera.pos,
         camera.rts,
+        0,
+        0,
+        camera.screenSize,
+        1,
+        1,
         0
     };
 
@@ -482,6 +682,8 @@ private:
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
     bool checkDeviceExtensionSupport(VkPhysicalDevice device);
     void createLogicalDevice();
+    uint32_t countPersistentWorkgroups();
+    VkFormat chooseOutputFormat();
 
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
     void createSwapChain();
@@ -494,11 +696,32 @@ private:
     void createFramebuffers();
 
     void createRenderPass();
+    void createPipelineCache();
+    void savePipelineCache();
     void createGraphicsPipeline();
     void createComputePipeline();
+    void createComputeKernels();
+    void destroyComputeKernels();
+    bool pollShaderChanges();
+    VkPipeline getTraceVariant(uint32_t features);
 
     void recordGraphicsCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    bool chooseDirectPresentFormat(const SwapChainSupportDetails& support, VkSurfaceFormatKHR& surfaceFormat);
+    void createPresentPipeline();
+    void createPresentDescriptorSets();
+    void recordDirectPresent(VkCommandBuffer commandBuffer, uint32_t imageIndex);
     void recordComputeCommandBuffer(VkCommandBuffer commandBuffer);
+    ComputeCommandsKey computeCommandsKey();
+    void writeFrameState();
+    void createWavefrontPipelines(VkComputePipelineCreateInfo pipelineInfo);
+    void createTimestampQueries();
+    void recordFrameTimestamp(VkCommandBuffer commandBuffer, bool end);
+    void transferComputeOwnership();
+    void recordOutputTransfer(VkCommandBuffer commandBuffer, bool toGraphics, bool release);
+    void readFrameTimestamps();
+    bool updateTraceExtent(bool interactive);
+    void recordWavefrontCommands(VkCommandBuffer commandBuffer, VkBuffer tileBuffer);
+    void readWavefrontRounds();
 
     void createSyncObjects();
     void drawFrame();
@@ -512,7 +735,11 @@ private:
      *  TODO: MAKE FUNCTIONAL.
      */
     void createGraphicsCommandBuffers() {
-        graphicsCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        // (Called again when the swapchain is recreated, as its image count may change)
+        if (!graphicsCommandBuffers.empty())
+            vkFreeCommandBuffers(device, commandPool, (uint32_t)graphicsCommandBuffers.size(), graphicsCommandBuffers.data());
+        graphicsCommandBuffers.resize(framesInFlight * swapChainImages.size());
+        graphicsCommandsVersions.assign(graphicsCommandBuffers.size(), 0);
 
         // Create command buffer allocator
         VkCommandBufferAllocateInfo allocInfo{};
@@ -532,12 +759,13 @@ private:
      *  TODO: MAKE FUNCTIONAL.
      */
     void createComputeCommandBuffers() {
-        computeCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        computeCommandBuffers.resize(framesInFlight);
+        computeCommandsKeys.assign(framesInFlight, ComputeCommandsKey{});
 
         // Create command buffer allocator
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.commandPool = commandPool;
+        allocInfo.commandPool = computeCommandPool;
         // VK_COMMAND_BUFFER_LEVEL_PRIMARY   - Can be submitted, cannot be called from other command buffers.
         // VK_COMMAND_BUFFER_LEVEL_SECONDARY - Cannot be submitted, can be called from primary buffers (good for reuse).
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
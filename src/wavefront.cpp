@@ -0,0 +1,109 @@
+#include "vulkanApplication.h"
+
+#include <string>
+#include <algorithm>
+
+
+/**
+ *  Records a global memory barrier between compute work (or between compute work and the host).
+ */
+static void wavefrontBarrier(
+    VkCommandBuffer         commandBuffer,
+    VkPipelineStageFlags    srcStage,
+    VkAccessFlags           srcAccess,
+    VkPipelineStageFlags    dstStage,
+    VkAccessFlags           dstAccess
+) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+/**
+ *  Creates one pipeline per wavefront stage, of the active metric's variant.
+ *
+ *  @param pipelineInfo The trace pipeline's create info, whose layout the stages share.
+ */
+void VulkanApplication::createWavefrontPipelines(VkComputePipelineCreateInfo pipelineInfo) {
+    const char* stageNames[WAVEFRONT_STAGE_COUNT] = { "raygen", "bend", "intersect", "shade", "resolve" };
+
+    for (uint32_t stage = 0; stage < WAVEFRONT_STAGE_COUNT; stage++) {
+        auto shaderCode = loadShader("wavefront_" + std::string(stageNames[stage]) + ActiveMetric::variantSuffix + ".spv");
+        VkShaderModule shaderModule = createShaderModule(shaderCode);
+        pipelineInfo.stage.module = shaderModule;
+
+        if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &wavefrontPipelines[stage]) != VK_SUCCESS)
+            throw std::runtime_error("ERR::VULKAN::CREATE_WAVEFRONT_PIPELINES::PIPELINE_CREATION_FAILED");
+
+        vkDestroyShaderModule(device, shaderModule, nullptr);
+    }
+}
+
+/**
+ *  Records wavefront tracing of the listed tiles.
+ *  Every wave traces one ray per pixel: generate, then wavefrontRounds rounds of bend, intersect and shade,
+ *  each dispatched indirectly over its input queue, and finally resolve into the accumulation image.
+ *  The queues are emptied by the stages themselves: each by the stage consuming it, and all of them by the resolve.
+ *
+ *  @param commandBuffer The command buffer, with the trace descriptors bound.
+ *  @param tileBuffer The tile list, whose header holds the indirect dispatch arguments of the per-tile stages.
+ */
+void VulkanApplication::recordWavefrontCommands(VkCommandBuffer commandBuffer, VkBuffer tileBuffer) {
+    VkBuffer queueBuffer = computeBundle.bufferMemories[b_rayQueues].buffers[currentFrame];
+
+    const VkPipelineStageFlags  computeStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    const VkAccessFlags         computeAccess = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    auto run = [&](uint32_t stage, VkBuffer buffer, VkDeviceSize offset) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, wavefrontPipelines[stage]);
+        vkCmdDispatchIndirect(commandBuffer, buffer, offset);
+        wavefrontBarrier(commandBuffer, computeStages, computeAccess, computeStages, computeAccess);
+    };
+
+    for (uint32_t wave = 0; wave < frame.raysPerFrag; wave++) {
+        // Every wave accumulates one sample per pixel, on top of the previous waves
+        // (The kernels derive the wave's frame state from the frame's, see wavefront.comp)
+        RTDispatch dispatch{ wave, 0, 0 };
+        vkCmdPushConstants(commandBuffer, computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(RTDispatch), &dispatch);
+
+        // Generate camera rays into the bend queue
+        run(WAVEFRONT_RAYGEN, tileBuffer, 0);
+
+        // Step the rays
+        // (Bend -> intersect, intersect -> shade on hits and bend on misses, shade -> intersect or bend)
+        for (uint32_t round = 0; round < wavefrontRounds; round++) {
+            dispatch.round = round;
+            vkCmdPushConstants(commandBuffer, computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(RTDispatch), &dispatch);
+            run(WAVEFRONT_BEND, queueBuffer, 0 * sizeof(RTQueue));
+            run(WAVEFRONT_INTERSECT, queueBuffer, 1 * sizeof(RTQueue));
+            run(WAVEFRONT_SHADE, queueBuffer, 2 * sizeof(RTQueue));
+        }
+
+        // Resolve every ray of the listed tiles
+        run(WAVEFRONT_RESOLVE, tileBuffer, 0);
+    }
+
+    // Hand the rounds used to the host (see readWavefrontRounds)
+    wavefrontBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+}
+
+/**
+ *  Picks how many bend/intersect/shade rounds to record per wave, from how many the compute work which last used this slot needed.
+ *  Rounds after every ray is done only cost empty dispatches and barriers, so only a few are kept beyond what was used,
+ *  and if even the last recorded round had rays, the count doubles (up to WAVEFRONT_ITERATIONS).
+ *  Must be called once the slot's last frame has finished (see drawFrame), and before the next is submitted.
+ */
+void VulkanApplication::readWavefrontRounds() {
+    if (TRACE_MODE != TraceMode::Wavefront) return;
+
+    uint32_t* roundsUsed = (uint32_t*)computeBundle.bufferMemories[b_wavefrontRounds].buffersMapped[currentFrame];
+    uint32_t used = *roundsUsed, recorded = computeCommandsKeys[currentFrame].wavefrontRounds;
+    *roundsUsed = 0;
+    if (used == 0 || recorded == 0) return; // (Nothing was traced, or the slot wasn't used yet)
+
+    // (Rounded up to 4, so that the commands aren't recorded again for every small change)
+    uint32_t rounds = used >= recorded ? 2 * recorded : (used + WAVEFRONT_ROUND_MARGIN + 3) / 4 * 4;
+    wavefrontRounds = std::min(rounds, WAVEFRONT_ITERATIONS);
+}